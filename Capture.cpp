@@ -0,0 +1,28 @@
+/*
+ * Codeline capture
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include <LocoNet.h>
+#include "Capture.h"
+
+void CaptureCodeLine::header(Print &out) {
+	byte buf[4] = { 'L', 'N', 'C', CAPTURE_VERSION };
+	out.write(buf, sizeof(buf));
+}
+
+void CaptureCodeLine::record(Print &out, lnMsg *msg, boolean sent, unsigned long time) {
+	byte buf[5];
+	byte len = getLnMsgSize(msg);
+	if (len < 2 || len > sizeof(lnMsg)) return;		// not a frame we could replay
+	buf[0] = len | (sent ? CAPTURE_SENT : 0);
+	buf[1] = time & 0xFF;
+	buf[2] = (time >> 8) & 0xFF;
+	buf[3] = (time >> 16) & 0xFF;
+	buf[4] = (time >> 24) & 0xFF;
+	out.write(buf, sizeof(buf));
+	out.write(msg->data, len);
+}
@@ -0,0 +1,58 @@
+/*
+ *    Codeline capture
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include <Arduino.h>
+#include <LocoNet.h>
+#include "Clock.h"
+#include "CodeLine.h"
+
+/*
+ * A CodeLine that records every frame passing through another one
+ *
+ *      CaptureCodeLine cap(&LocoNetLine, Serial);
+ *      cap.begin();                            // writes the file header
+ *      ControlPoint::defaultCP().codeline(&cap);
+ *
+ * The capture is binary, so a whole operating session fits where
+ * printLnPacket() would have managed a few minutes:
+ *
+ *      header  'L' 'N' 'C' CAPTURE_VERSION
+ *      record  0       frame length (2-16), | 0x80 if this end sent it
+ *              1-4     Clock::millis(), little endian
+ *              5...    the frame, exactly as on the wire
+ *
+ * tools/lncapture.cpp records the same format from a LocoNet serial bridge,
+ * prints it, and replays it through a control point.
+ *
+ * Writes go straight to out, so on a board keep the serial rate well above
+ * the 16.66 kbps of the LocoNet being recorded (57600 is plenty).
+ */
+#define CAPTURE_VERSION 1
+#define CAPTURE_SENT    0x80
+
+class CaptureCodeLine : public CodeLine {
+public:
+	CaptureCodeLine(CodeLine *line, Print &out)  { _line = line; _out = &out; };
+
+	void   begin(void)                          { header(*_out); };
+	lnMsg *receive(void)                        { lnMsg *m = _line->receive(); if (m) record(*_out, m, false, Clock::millis()); return m; };
+	lnMsg *frame(void)                          { return _line->frame(); };
+	int    send(lnMsg *msg)                     { record(*_out, msg, true, Clock::millis()); return _line->send(msg); };
+	void   flush(void)                          { _line->flush(); };
+
+	static void header(Print &out);
+	static void record(Print &out, lnMsg *msg, boolean sent, unsigned long time);
+private:
+	CodeLine *_line;
+	Print    *_out;
+};
+
+#endif
+
@@ -0,0 +1,14 @@
+/*
+ * Injectable time source
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include "Clock.h"
+
+unsigned long (*Clock::_source)(void) = ::millis;
+unsigned long   Clock::_now     = 0;
+CP_THREADLOCAL unsigned long   Clock::_next    = 0;
+CP_THREADLOCAL boolean         Clock::_pending = false;
@@ -0,0 +1,84 @@
+/*
+ *    Injectable time source
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+#include <Arduino.h>
+
+// Host builds may run several control points on different threads; give each
+// thread its own copy of the bookkeeping that isn't shared on purpose.
+#ifdef ARDUINO
+#define CP_THREADLOCAL
+#else
+#define CP_THREADLOCAL thread_local
+#endif
+
+/*
+ * Everything in the library that cares about time (switch slow motion,
+ * signal running time, head blinking, trace timestamps) asks Clock, not millis().
+ *
+ * By default Clock is the Arduino millis() counter.  A different source can be
+ * plugged in with Clock::use(fn), or the clock can be made virtual, where time
+ * only moves when told to.  Running timers report when they will next expire
+ * with Clock::deadline(), so a simulation can jump straight there:
+ *
+ *      Clock::virtualTime(0);
+ *      for (;;) {
+ *          ...script the layout: detectors, dispatcher codes...
+ *          ControlPoint::readall(); ... ControlPoint::writeall();
+ *          if (!Clock::skip()) Clock::advance(100);  // nothing pending, just tick
+ *      }
+ *
+ * A 10 second signal time then costs one scan instead of 10 seconds, and the
+ * result is the same every run.
+ */
+class Clock {
+public:
+	static unsigned long millis(void)              { return _source ? _source() : _now; };
+
+	static void use(unsigned long (*source)(void)) { _source = source; _pending = false; };
+	static void virtualTime(unsigned long start)   { _source = NULL; _now = start; _pending = false; };
+	static boolean isVirtual(void)                 { return _source == NULL; };
+
+	// virtual time only...
+	static void advance(unsigned long ms)          { _now += ms; };
+	static void deadline(unsigned long when)       {	// something will happen at "when"
+														if ((long)(when - millis()) <= 0) return;
+														if (!_pending || (long)(when - _next) < 0) {
+															_next = when;
+															_pending = true;
+														}
+													};
+	static boolean skip(void)                      {	// jump to the earliest reported deadline
+														if (!_pending) return false;
+														_pending = false;
+														if (isVirtual() && (long)(_next - _now) > 0) _now = _next;
+														return true;
+													};
+private:
+	static unsigned long (*_source)(void);
+	static unsigned long _now;
+	static CP_THREADLOCAL unsigned long _next;
+	static CP_THREADLOCAL boolean       _pending;
+};
+
+/*
+ * Drop in replacement for elapsedMillis that reads Clock
+ */
+class ElapsedTime {
+public:
+	ElapsedTime(void)                              { _start = Clock::millis(); };
+	operator unsigned long () const                { return Clock::millis() - _start; };
+	ElapsedTime & operator = (unsigned long val)   { _start = Clock::millis() - val; return *this; };
+	void deadline(unsigned long ms)                { Clock::deadline(_start + ms); };	// tell Clock when we go past ms
+private:
+	unsigned long _start;
+};
+
+#endif
+
@@ -0,0 +1,185 @@
+/*
+ * Codeline transports
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include <LocoNet.h>
+#include "CodeLine.h"
+
+LocoNetCodeLine LocoNetLine;
+
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+void FdCodeLine::_init(int fd) {
+	_fd      = -1;
+	_dropped = 0;
+	_inlen   = _inpos = _outlen = 0;
+	if (fd >= 0) attach(fd);
+}
+
+FdCodeLine::~FdCodeLine(void) {
+	flush();
+	if (_fd >= 0) close(_fd);
+}
+
+void FdCodeLine::attach(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	_fd    = fd;
+	_inlen = _inpos = _outlen = 0;
+}
+
+void FdCodeLine::hangup(void) {
+	close(_fd);
+	_fd     = -1;
+	_outlen = 0;
+}
+
+lnMsg *FdCodeLine::receive(void) {
+	poll();
+	flush();			// what this scan sent goes out before we look for answers
+	for (;;) {
+		// frames are handed out where they sit in _in
+		while (_inpos < _inlen) {
+			byte *p = &_in[_inpos];
+			int have = _inlen - _inpos;
+			if (!(p[0] & 0x80)) { _inpos++; continue; }		// resync on an opcode
+			if (have < 2) break;
+			int n = getLnMsgSize((lnMsg *)p);
+			if (n < 2 || n > (int)sizeof(lnMsg)) { _dropped++; _inpos++; continue; }
+			if (have < n) break;
+			byte checksum = 0;
+			for (int i = 0; i < n; i++) checksum ^= p[i];
+			if (checksum != 0xFF) { _dropped++; _inpos++; continue; }
+			_inpos += n;
+			return (lnMsg *)p;
+		}
+		if (_fd < 0) return NULL;
+		if (_inpos) {		// keep any partial frame, drop what's been handed out
+			memmove(_in, &_in[_inpos], _inlen - _inpos);
+			_inlen -= _inpos;
+			_inpos  = 0;
+		}
+		int got = read(_fd, &_in[_inlen], CP_FDBUFFER - _inlen);
+		if (got > 0) {
+			_inlen += got;
+			continue;
+		}
+		if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) hangup();
+		return NULL;
+	}
+}
+
+lnMsg *FdCodeLine::frame(void) {
+	if (_outlen + (int)sizeof(lnMsg) > CP_FDBUFFER) flush();
+	if (_outlen + (int)sizeof(lnMsg) > CP_FDBUFFER) return &_frame;
+	return (lnMsg *)&_out[_outlen];
+}
+
+int FdCodeLine::send(lnMsg *msg) {
+	int n = getLnMsgSize(msg);
+	if (n < 2 || n > (int)sizeof(lnMsg)) return LN_UNKNOWN_ERROR;
+	if (_fd < 0) poll();
+	if (_fd < 0) return LN_NETWORK_BUSY;
+	if (_outlen + n > CP_FDBUFFER) flush();
+	if (_outlen + n > CP_FDBUFFER) return LN_NETWORK_BUSY;
+	if ((byte *)msg != &_out[_outlen]) memcpy(&_out[_outlen], msg, n);
+	_outlen += n;
+	return LN_DONE;
+}
+
+void FdCodeLine::flush(void) {
+	while (_outlen && _fd >= 0) {
+		int put = ::send(_fd, _out, _outlen, MSG_NOSIGNAL);
+		if (put < 0 && errno == ENOTSOCK) put = write(_fd, _out, _outlen);
+		if (put > 0) {
+			memmove(_out, &_out[put], _outlen - put);
+			_outlen -= put;
+		} else if (put < 0 && errno == EINTR) {
+			continue;
+		} else if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;			// try again next time
+		} else {
+			hangup();		// may keep _fd (PtyCodeLine), so don't try again now
+			break;
+		}
+	}
+}
+
+PtyCodeLine::PtyCodeLine(void) {
+	_name[0] = '\0';
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+		if (fd >= 0) close(fd);
+		return;
+	}
+	struct termios t;
+	if (tcgetattr(fd, &t) == 0) {		// 8 bit clean, no echo, no line editing
+		cfmakeraw(&t);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+	snprintf(_name, sizeof(_name), "%s", ptsname(fd));		// always terminated, cut short if need be
+	attach(fd);
+}
+
+UnixCodeLine::UnixCodeLine(const char *path, boolean server) {
+	snprintf(_path, sizeof(_path), "%s", path);
+	_server = server;
+	_listen = -1;
+	if (_server) {
+		struct sockaddr_un a;
+		memset(&a, 0, sizeof(a));
+		a.sun_family = AF_UNIX;
+		snprintf(a.sun_path, sizeof(a.sun_path), "%s", _path);
+		_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(_path);
+		if (_listen < 0 || bind(_listen, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(_listen, 1) < 0) {
+			if (_listen >= 0) close(_listen);
+			_listen = -1;
+			return;
+		}
+		fcntl(_listen, F_SETFL, fcntl(_listen, F_GETFL) | O_NONBLOCK);
+	}
+	poll();
+}
+
+UnixCodeLine::~UnixCodeLine(void) {
+	if (_listen >= 0) {
+		close(_listen);
+		unlink(_path);
+	}
+}
+
+void UnixCodeLine::poll(void) {
+	if (_fd >= 0) return;
+	if (_server) {			// one peer at a time; a new one may connect after the last hangs up
+		if (_listen < 0) return;
+		int fd = accept(_listen, NULL, NULL);
+		if (fd >= 0) attach(fd);
+	} else {
+		struct sockaddr_un a;
+		memset(&a, 0, sizeof(a));
+		a.sun_family = AF_UNIX;
+		snprintf(a.sun_path, sizeof(a.sun_path), "%s", _path);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) return;
+		if (connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+			close(fd);		// server not up yet, try again next scan
+			return;
+		}
+		attach(fd);
+	}
+}
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ *    Codeline transports
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef CODELINE_H
+#define CODELINE_H
+#include <Arduino.h>
+#include <LocoNet.h>
+
+/*
+ * What a control point's codeline packets travel over
+ *
+ * receive() hands back the next frame in place - no copy - and the frame stays
+ * valid until the next receive().  Senders ask for frame(), build the packet
+ * right there, and send() it; transports that can, hand out space in their
+ * own buffers so the packet is never copied either.
+ *
+ * Transports that batch (the host ones) hold sent frames until flush(), until
+ * their buffer fills, or until the next receive(), so a whole scan's worth of
+ * packets goes out in one system call.
+ *
+ * waiting() says whether the transport already holds received bytes, so a
+ * reader that got a frame it didn't want knows to keep going instead of
+ * sleeping; fd() is a descriptor to poll() on for more, or -1 for none.
+ *
+ *  LocoNetCodeLine     the LocoNet library - the default
+ *  QueueCodeLine       an in-memory queue to another QueueCodeLine, e.g. two
+ *                      control points on one board, or a test harness
+ *  FdCodeLine          (host only) LocoNet bytes over any file descriptor
+ *  PtyCodeLine         (host only) ...over a pseudo-terminal, for a
+ *                      LocoNet-to-serial bridge or JMRI style tool to attach to
+ *  UnixCodeLine        (host only) ...over a UNIX domain socket
+ */
+class CodeLine {
+public:
+	virtual lnMsg *receive(void) = 0;
+	virtual lnMsg *frame(void)            { return &_frame; };
+	virtual int    send(lnMsg *msg) = 0;	// returns a LN_STATUS
+	virtual void   flush(void)            { };
+	virtual boolean waiting(void)         { return false; };
+	virtual int    fd(void)               { return -1; };
+protected:
+	lnMsg _frame;
+};
+
+class LocoNetCodeLine : public CodeLine {
+public:
+	lnMsg *receive(void)                  { return LocoNet.receive(); };
+	int    send(lnMsg *msg)               { return (int)LocoNet.send(msg); };
+};
+extern LocoNetCodeLine LocoNetLine;
+
+#ifndef CP_QUEUESIZE
+#define CP_QUEUESIZE 4		// frames, 16 bytes of RAM each
+#endif
+
+class QueueCodeLine : public CodeLine {
+public:
+	QueueCodeLine(void)                   { _head = _count = 0; _held = false; _peer = this; };
+	void   connect(QueueCodeLine *peer)   { _peer = peer; peer->_peer = this; };
+
+	lnMsg *receive(void) {
+		release();
+		if (!_count) return NULL;
+		_held = true;				// keep the slot until the next receive()
+		return &_ring[tail()];
+	};
+	lnMsg *frame(void)                    { return _peer->slot(); };	// straight into the other end's queue
+	int    send(lnMsg *msg)               { return _peer->commit(msg); };
+	boolean waiting(void)                 { return _count > (_held ? 1 : 0); };
+
+private:
+	byte   tail(void)                     { return (_head + CP_QUEUESIZE - _count) % CP_QUEUESIZE; };
+	void   release(void)                  { if (_held) { _count--; _held = false; } };
+	lnMsg *slot(void)                     { return (_count < CP_QUEUESIZE) ? &_ring[_head] : &_frame; };
+	int    commit(lnMsg *msg) {
+		if (_count == CP_QUEUESIZE) return LN_NETWORK_BUSY;
+		if (msg != &_ring[_head]) _ring[_head] = *msg;
+		_head = (_head + 1) % CP_QUEUESIZE;
+		_count++;
+		return LN_DONE;
+	};
+
+	lnMsg          _ring[CP_QUEUESIZE];
+	byte           _head;
+	byte           _count;
+	boolean        _held;
+	QueueCodeLine *_peer;
+};
+
+#ifndef ARDUINO
+
+#define CP_FDBUFFER 4096
+
+class FdCodeLine : public CodeLine {
+public:
+	FdCodeLine(int fd)                    { _init(fd); };	// takes ownership of fd
+	~FdCodeLine(void);
+
+	lnMsg *receive(void);
+	lnMsg *frame(void);
+	int    send(lnMsg *msg);
+	void   flush(void);
+	int    fd(void)                       { return _fd; };
+	boolean waiting(void)                 { return _inpos < _inlen; };
+	long   dropped(void)                  { return _dropped; };	// bad checksums, oversize frames
+protected:
+	FdCodeLine(void)                      { _init(-1); };
+	void   _init(int fd);
+	void   attach(int fd);
+	virtual void poll(void)               { };		// chance to (re)connect
+	virtual void hangup(void);
+
+	int    _fd;
+	byte   _in[CP_FDBUFFER + sizeof(lnMsg)];
+	int    _inlen;
+	int    _inpos;
+	byte   _out[CP_FDBUFFER + sizeof(lnMsg)];
+	int    _outlen;
+	long   _dropped;
+};
+
+class PtyCodeLine : public FdCodeLine {
+public:
+	PtyCodeLine(void);
+	const char *name(void)                { return _name; };	// the /dev/pts/N end for the other program
+private:
+	void   hangup(void)                   { _outlen = 0; };	// nobody attached: keep the master, drop what they missed
+	char   _name[64];
+};
+
+class UnixCodeLine : public FdCodeLine {
+public:
+	UnixCodeLine(const char *path, boolean server);	// server: listen on path, else connect to it
+	~UnixCodeLine(void);
+private:
+	void   poll(void);
+	char   _path[108];
+	boolean _server;
+	int    _listen;
+};
+
+#endif
+
+#endif
+
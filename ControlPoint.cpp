@@ -9,6 +9,7 @@
 #include <ControlPoint.h>
 #include <LocoNet.h>
 #include <EEPROM.h>
+#include <avr/pgmspace.h>
 
 
 // #define DEBUG
@@ -21,21 +22,80 @@ void ControlPoint::initializeCodeLine(int lnrx, int lntx) {
 
 // utility routine, used for debugging low mwmory problems...
 int ControlPoint::freeRam () {
+#ifdef ARDUINO
   extern int __heap_start, *__brkval; 
   int v; 
   return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval); 
+#else
+  return 0;		// host build, no AVR heap to measure
+#endif
+}
+
+ControlPoint *ControlPoint::_first = NULL;
+
+static boolean      _defaultbound = false;
+
+ControlPoint::~ControlPoint(void) {
+	for (ControlPoint **p = &_first; *p; p = &(*p)->_next) {
+		if (*p == this) {
+			*p = _next;
+			break;
+		}
+	}
+}
+
+// The default control point, made from the tables in the main sketch - only
+// there (and taking RAM) in sketches that use the static calls
+ControlPoint &ControlPoint::defaultCP(void) {
+	static ControlPoint _defaultcp;
+	if (!_defaultbound) {
+		_defaultcp.tables(m, getNumPorts(), track, getNumTrackCircuits(), sw, getNumSwitches(),
+		                  sig, getNumSignals(), head, getNumHeads(), mc, getNumCalls());
+		_defaultbound = true;
+	}
+	return _defaultcp;
+}
+
+void ControlPoint::tables(I2Cextender  *ports,  int nports,
+                          TrackCircuit *tracks, int ntracks,
+                          Switch       *sws,    int nswitches,
+                          RRSignal     *sigs,   int nsignals,
+                          RRSignalHead *heads,  int nheads,
+                          Maintainer   *calls,  int ncalls) {
+	_m     = ports;   _nports    = nports;
+	_track = tracks;  _ntracks   = ntracks;
+	_sw    = sws;     _nswitches = nswitches;
+	_sig   = sigs;    _nsignals  = nsignals;
+	_head  = heads;   _nheads    = nheads;
+	_mc    = calls;   _ncalls    = ncalls;
 }
 
 // Initialize any control point specifics...
-int savedcontrols[8];
-int usesavedstate = 0;
-void ControlPoint::setup(void) {
-	usesavedstate = 0;
-	restorestate();
+void ControlPoint::begin(void) {
+	int x;
+	// number the devices so traces can say which one changed
+	for (x = 0; x < _ntracks; x++)   { _track[x].id(x); }
+	for (x = 0; x < _nswitches; x++) { _sw[x]   .id(x); }
+	for (x = 0; x < _nsignals; x++)  { _sig[x]  .id(x); }
+	for (x = 0; x < _nheads; x++)    { _head[x] .id(x); }
+	dependencies();
+	interlocking();
+	light();
+	_dirtyheads = ~0UL;		// evaluate and write everything once
+	_dirtyports = ~0UL;
+	_usesavedstate = 0;
+	_handoff.clear();
+	_grouped.clear();
+	restore();
+	ask();
+	if (_address) {
+		int data[8] = { RENEW, 0, 0, 0, 0, 0, 0, 0 };	// listeners: subscribe() to us again
+		announce(data);
+	}
 }
 
 /* 
- *  EEPROM memory map
+ *  EEPROM memory map, per control point, starting at slot * CP_EEPROM_SLOTSIZE
  *
  *      0     flag == 42
  *      1     checksum of control packet
@@ -48,142 +108,570 @@ void ControlPoint::setup(void) {
  *     15     controls[5]
  *     16     controls[6]
  *     17     controls[7]
- *     19-... unused
+ *     18-... unused
  *
+ * The flag is cleared before the controls are rewritten and set again
+ * after the checksum, so a reset part way through a save leaves no flag.
  */
-void ControlPoint::savestate(int *controls) {
+void ControlPoint::save(int *controls) {
 	// save last state in EEPROM, restore on restart...
+	int base = _slot * CP_EEPROM_SLOTSIZE;
 	byte csum = 0;
-	EEPROM.write(0, 42);
-	for (int x = 0; x < 7; x++) {
-		EEPROM.write(10+x, controls[x]);
+	EEPROM.write(base + 0, 0);
+	for (int x = 0; x < 8; x++) {
+		EEPROM.write(base + 10+x, controls[x]);
 		csum += controls[x];
 	}
-	EEPROM.write(1, csum);
+	EEPROM.write(base + 1, csum);
+	EEPROM.write(base + 0, 42);
+	TRACEEVENT(Trace::EEPROMWRITE, _slot, csum, 0);
+}
+
+/*
+ * The same thing in the background: each EEPROM write takes 3.3 ms, so
+ * persist() writes at most one byte per call, and skips the ones that
+ * already hold the right value.  As in save(), the flag is cleared first
+ * and set last, so a reset part way through leaves no flag and restore()
+ * plays it safe.  Saving what's already there writes nothing at all.
+ */
+void ControlPoint::saveLater(int *controls) {
+	int base = _slot * CP_EEPROM_SLOTSIZE;
+	byte csum = 0;
+	boolean same = (EEPROM.read(base + 0) == 42);
+	for (int x = 0; x < 8; x++) {
+		_persistcontrols[x] = controls[x];
+		csum += _persistcontrols[x];
+		same &= (EEPROM.read(base + 10 + x) == _persistcontrols[x]);
+	}
+	same &= (EEPROM.read(base + 1) == csum);
+	_persiststep = same ? CP_PERSISTIDLE : 0;
 }
-void ControlPoint::restorestate(void) {
-	byte csum;
+boolean ControlPoint::persist(void) {
+	int base = _slot * CP_EEPROM_SLOTSIZE;
+	while (_persiststep != CP_PERSISTIDLE) {
+		int addr;
+		byte value;
+		if (_persiststep == 0) {		// invalidate
+			addr  = base + 0;
+			value = 0;
+		} else if (_persiststep < 9) {
+			addr  = base + 10 + _persiststep - 1;
+			value = _persistcontrols[_persiststep - 1];
+		} else if (_persiststep == 9) {
+			addr  = base + 1;
+			value = 0;
+			for (int x = 0; x < 8; x++) value += _persistcontrols[x];
+		} else {
+			addr  = base + 0;
+			value = 42;
+		}
+		_persiststep = (_persiststep == 10) ? CP_PERSISTIDLE : _persiststep + 1;
+		if (_persiststep == CP_PERSISTIDLE) TRACEEVENT(Trace::EEPROMWRITE, _slot, EEPROM.read(base + 1), 0);
+		if (EEPROM.read(addr) != value) {
+			EEPROM.write(addr, value);
+			break;
+		}
+	}
+	return _persiststep != CP_PERSISTIDLE;
+}
+void ControlPoint::restore(void) {
+	int base = _slot * CP_EEPROM_SLOTSIZE;
+	byte csum = 0;
 	byte goodinfo = 1;
 	
-	if (EEPROM.read(0) != 42) {
+	if (EEPROM.read(base + 0) != 42) {
 		goodinfo = 0;
 	}
-	for (int x = 0; x < 7; x++) {
-		savedcontrols[x] = EEPROM.read(10+x);
-		csum += savedcontrols[x];
+	for (int x = 0; x < 8; x++) {
+		_savedcontrols[x] = EEPROM.read(base + 10+x);
+		csum += _savedcontrols[x];
 	}
-	if (csum != EEPROM.read(1)) {
+	if (csum != EEPROM.read(base + 1)) {
 		goodinfo = 0;
 	}
 	
 	if (goodinfo) {
-		usesavedstate = 1;
+		_usesavedstate = 1;
 	} else {
 		// no state to restore, so be safe
 		// set all switches to NORMAL, all signals to STOP
-		for (int x = 0; x <  getNumSwitches(); x++) {
-	        sw[x].set(Switch::NORMAL);
+		for (int x = 0; x < _nswitches; x++) {
+	        _sw[x].set(Switch::NORMAL);
 	    }
-	    for (int x = 0; x <  getNumSignals(); x++) {
-	        sig[x].knockdown();
-	        sig[x].report();
+	    for (int x = 0; x < _nsignals; x++) {
+	        _sig[x].knockdown();
+	        _sig[x].report();
 	    }
 	}
 }
 
-int ControlPoint::LnPacket2Controls(int *src, int *dst, int *controls) {
+void ControlPoint::unpackPacket(lnMsg *LnPacket, int *src, int *dst, int *controls) {
+    *src = (byte)LnPacket->px.src;
+    *dst = (((byte)LnPacket->px.dst_h & 0x7f) << 7) | ((byte)LnPacket->px.dst_l & 0x7f);
+    controls[0] = (byte)LnPacket->px.d1;  
+    controls[1] = (byte)LnPacket->px.d2;  
+    controls[2] = (byte)LnPacket->px.d3;
+    controls[3] = (byte)LnPacket->px.d4;
+    controls[4] = (byte)LnPacket->px.d5;  
+    controls[5] = (byte)LnPacket->px.d6;  
+    controls[6] = (byte)LnPacket->px.d7;
+    controls[7] = (byte)LnPacket->px.d8;
+    if ((byte)LnPacket->px.pxct1 & B00000001) controls[0] |= B10000000;
+    if ((byte)LnPacket->px.pxct1 & B00000010) controls[1] |= B10000000;
+    if ((byte)LnPacket->px.pxct1 & B00000100) controls[2] |= B10000000;
+    if ((byte)LnPacket->px.pxct1 & B00001000) controls[3] |= B10000000;
+ 
+    if ((byte)LnPacket->px.pxct2 & B00000001) controls[4] |= B10000000;
+    if ((byte)LnPacket->px.pxct2 & B00000010) controls[5] |= B10000000;
+    if ((byte)LnPacket->px.pxct2 & B00000100) controls[6] |= B10000000;
+    if ((byte)LnPacket->px.pxct2 & B00001000) controls[7] |= B10000000;
+}
+
+int ControlPoint::receive(int *src, int *dst, int *controls) {
 	lnMsg *LnPacket;
-	if (usesavedstate) {  // use saved state from last valid control packet to restore control point
-		for (int x = 0; x < 7; x++) {
-			controls[x] = savedcontrols[x];
-			savedcontrols[x] = 0; // prevent reuse...
+	if (_usesavedstate) {  // use saved state from last valid control packet to restore control point
+		for (int x = 0; x < 8; x++) {
+			controls[x] = _savedcontrols[x];
+			_savedcontrols[x] = 0; // prevent reuse...
 		}
-		usesavedstate = 0;
+		_usesavedstate = 0;
 		return 2;
-	} else if ((LnPacket = LocoNet.receive())) {
+	} else if (_handoff.get(src, dst, controls) || _grouped.get(src, dst, controls)) {	// another control point on this board picked it up for us
+		TRACEEVENT(Trace::RX, *src, *dst & 0xFF, (*dst >> 8) & 0xFF);
+		return 1;
+	} else if ((LnPacket = _codeline->receive())) {
+#ifdef CP_STATS
+	    _frames++;
+#endif
 	    unsigned char opcode = (int)LnPacket->sz.command;
 	    *src = (byte)LnPacket->px.src;
 	    *dst = (((byte)LnPacket->px.dst_h & 0x7f) << 7) | ((byte)LnPacket->px.dst_l & 0x7f);
 	    if (opcode == OPC_PEER_XFER) {
-	        controls[0] = (byte)LnPacket->px.d1;  
-	        controls[1] = (byte)LnPacket->px.d2;  
-	        controls[2] = (byte)LnPacket->px.d3;
-	        controls[3] = (byte)LnPacket->px.d4;
-	        controls[4] = (byte)LnPacket->px.d5;  
-	        controls[5] = (byte)LnPacket->px.d6;  
-	        controls[6] = (byte)LnPacket->px.d7;
-	        controls[7] = (byte)LnPacket->px.d8;
-	        if ((byte)LnPacket->px.pxct1 & B00000001) controls[0] |= B10000000;
-	        if ((byte)LnPacket->px.pxct1 & B00000010) controls[1] |= B10000000;
-	        if ((byte)LnPacket->px.pxct1 & B00000100) controls[2] |= B10000000;
-	        if ((byte)LnPacket->px.pxct1 & B00001000) controls[3] |= B10000000;
-         
-	        if ((byte)LnPacket->px.pxct2 & B00000001) controls[4] |= B10000000;
-	        if ((byte)LnPacket->px.pxct2 & B00000010) controls[5] |= B10000000;
-	        if ((byte)LnPacket->px.pxct2 & B00000100) controls[6] |= B10000000;
-	        if ((byte)LnPacket->px.pxct2 & B00001000) controls[7] |= B10000000;
+	        if (*dst == CP_ASPECTADDRESS) {
+	            // everyone on this codeline gets to hear about aspects
+	            int data[8];
+	            unpackPacket(LnPacket, src, dst, data);
+	            for (ControlPoint *cp = _first; cp; cp = cp->_next) {
+	                if (cp->_codeline == _codeline) cp->heard(*src, data);
+	            }
+	            return 0;
+	        }
+	        if (isGroup(*dst)) {
+	            // a publisher's indications - for whoever on this codeline subscribed to it
+	            int publisher = *dst & ~CP_GROUPADDRESS;
+	            for (ControlPoint *cp = _first; cp; cp = cp->_next) {
+	                if (cp != this && cp->_codeline == _codeline && cp->listens(publisher)) {
+	                    unpackPacket(LnPacket, src, dst, controls);
+	                    cp->handoff(*src, *dst, controls);
+	                }
+	            }
+	            if (_address && !listens(publisher)) return 0;
+	            unpackPacket(LnPacket, src, dst, controls);
+	            TRACEEVENT(Trace::RX, *src, *dst & 0xFF, (*dst >> 8) & 0xFF);
+	            return 1;
+	        }
+	        if (_address && (*dst != _address)) {
+	            // not ours - if it belongs to another control point on this codeline, hand it over
+	            for (ControlPoint *cp = _first; cp; cp = cp->_next) {
+	                if (cp != this && cp->_codeline == _codeline && cp->_address && cp->_address == *dst) {
+	                    int data[8];
+	                    unpackPacket(LnPacket, src, dst, data);
+	                    cp->handoff(*src, *dst, data);
+	                    break;
+	                }
+	            }
+	            return 0;
+	        }
+	        unpackPacket(LnPacket, src, dst, controls);
+	        TRACEEVENT(Trace::RX, *src, *dst & 0xFF, (*dst >> 8) & 0xFF);
 	        return 1;
 	    }
     }
     return 0;
 }
 
-boolean ControlPoint::readall(void) {
+boolean ControlPoint::read(void) {
     boolean somethingchanged = false; 
     int x;  
     // Read all the inputs from the cTc Panel...
-    for (x = 0; x < getNumPorts(); x++) {
-        m[x].get();
-        somethingchanged |= m[x].changed();
+    for (x = 0; x < _nports; x++) {
+        _m[x].get();
+        somethingchanged |= _m[x].changed();
     }  
 
-    if (somethingchanged) {
+    // A control point without ports reads everything through callbacks,
+    // so there is no port to say whether anything changed - always look
+    if (somethingchanged || (_nports == 0)) {
         // Pick out bits from the layout and populate the various data structures
         // Track Circuits
-        for (x = 0; x < getNumTrackCircuits(); x++) { 
-          track[x].unpack();
+        for (x = 0; x < _ntracks; x++) { 
+          _track[x].unpack();
         }
         // Switch position feedback
-        for (x = 0; x < getNumSwitches(); x++) { 
-          sw[x].unpack();
+        for (x = 0; x < _nswitches; x++) { 
+          _sw[x].unpack();
         }
     } 
 
     // Run a switch in slow motion if needed...
     // This is a simulated delay for the points to actually move, so the final indication packet
     // generated by a change from Normal to Reverse (or vice versa) isn't sent immediatly.  
-    for (int x = 0; x < getNumSwitches(); x++) {
-        Switch::Timer cc = sw[x].runSlowMotion();
+    // Switches with feedback() finish when their points report in, or go to ERROR.
+    for (int x = 0; x < _nswitches; x++) {
+        Switch::Timer cc = _sw[x].runSlowMotion();
         somethingchanged |= (cc == Switch::EXPIRED);
     }
+    // and the signals' running time
+    for (int x = 0; x < _nsignals; x++) {
+        if (_sig[x].isRunningTime()) {
+            _sig[x].runTime();
+            somethingchanged |= !_sig[x].isRunningTime();
+        }
+    }
+    collect();
+    release();
     return somethingchanged;
 }
 
 /*
- * write out all the output device bits to the layout
+ * Hand every head whose inputs changed to the sketch's evaluation function
  */
-void ControlPoint::writeall(void) {
+void ControlPoint::evaluate(void (*fn)(int head)) {
+    collect();
+    unsigned long d = _dirtyheads | _alwaysheads;
+    _dirtyheads = 0;
+    for (int x = 0; x < _nheads; x++) {
+        if ((x >= CP_MAXHEADS) || bitRead(d, x)) {
+            fn(x);
+        }
+    }
+}
+
+/*
+ * Check every switch and signal change a control packet asks for, then make all of them or none
+ */
+byte ControlPoint::apply(int *controls) {
+    byte why = ACCEPTED;
+    unsigned long normal = 0, reverse = 0;	// where the switches will be
+    unsigned long setting = 0;				// routes this packet locks
+    int x;
+    collect();
+    for (x = 0; x < _ncalls; x++) {
+        _mc[x].fromControls(controls);
+    }
+    for (x = 0; x < _nswitches; x++) {
+        Switch::State s = _sw[x].target();
+        if (_sw[x].hasControls()) {
+            Switch::State c = _sw[x].fromControls(controls);
+            if (!_sw[x].check(c)) {
+                why |= BADSWITCH;
+            } else if (((c == Switch::NORMAL) || (c == Switch::REVERSE)) && (c != s)) {
+                if ((x < 32) && bitRead(_lockedswitches, x)) why |= LOCKED;
+                s = c;
+            }
+        }
+        if (x < 32) {
+            bitWrite(normal,  x, s == Switch::NORMAL);
+            bitWrite(reverse, x, s == Switch::REVERSE);
+        }
+    }
+    for (x = 0; x < _nsignals; x++) {
+        if (_sig[x].hasControls()) {
+            RRSignal::State s = _sig[x].fromControls(controls);
+            if ((s != RRSignal::UNKNOWN) && !_sig[x].check(s)) {
+                why |= SIGNALNOTSTOP;
+            } else if (((s == RRSignal::LEFT) || (s == RRSignal::RIGHT)) && (_sig[x].target() != s)
+                       && (x < 32) && bitRead(_routedsignals, x)) {
+                byte r = lined(x, s, normal, reverse);
+                if ((r == 0xFF) || (_route[r].tracks() & _occupied) || (_route[r].conflicts() & (_locked | setting))) {
+                    why |= LOCKED;
+                } else {
+                    bitSet(setting, r);
+                }
+            }
+        }
+    }
+    if (why != ACCEPTED) return why;
+
+    for (x = 0; x < _nswitches; x++) {
+        if (_sw[x].hasControls()) _sw[x].set(_sw[x].fromControls(controls));
+    }
+    for (x = 0; x < _nsignals; x++) {
+        if (_sig[x].hasControls()) {
+            RRSignal::State s = _sig[x].fromControls(controls);
+            if (s != RRSignal::UNKNOWN) _sig[x].set(s);
+        }
+    }
+    if (setting) {
+        for (x = 0; x < _nroutes; x++) {
+            if (bitRead(setting, x)) TRACEEVENT(Trace::ROUTE, x, 1, _route[x].signal());
+        }
+        _locked |= setting;
+        lockSwitches();
+    }
+    return ACCEPTED;
+}
+
+/*
+ * Build the indication packet from the devices, and report which bits changed since the last send()
+ * returns a mask of the bytes that changed
+ */
+byte ControlPoint::indications(int *ind, int *changed) {
+    int x;
+    byte moved = 0;
+    for (x = 0; x < 8; x++) ind[x] = 0;
+    for (x = 0; x < _nswitches; x++) _sw[x].indicate(ind);
+    for (x = 0; x < _nsignals; x++)  _sig[x].indicate(ind);
+    for (x = 0; x < _ntracks; x++)   _track[x].indicate(ind);
+    for (x = 0; x < 8; x++) {
+        int c = _sentany ? (ind[x] ^ _lastind[x]) : 0xFF;
+        if (changed) changed[x] = c;
+        if (c) bitSet(moved, x);
+    }
+    return moved;
+}
+
+/*
+ * write out all the output device bits to the layout - but only for the ports that changed
+ */
+void ControlPoint::write(void) {
+    int x;
+    collect();
+    for (x = 0; x < _nheads; x++) {
+        if (_head[x].needsPack()) markPort(_head[x].port());
+    }
+    for (x = 0; x < _ncalls; x++) {
+        if (_mc[x].changed()) markPort(_mc[x].port());
+    }
+    if (!_dirtyports) return;	// nothing moved
+
+#define DIRTY(p)	(((p) == NULL) ? bitRead(_dirtyports, CP_CALLBACKS) :	\
+					 (((p) - _m) < CP_CALLBACKS) ? bitRead(_dirtyports, (p) - _m) : 1)
+
     // Take high level state and pack it up for output to the layout
-    for (int x = 0; x < getNumPorts(); x++) {
-        m[x].next = 0;    /// Start with a known state
+    for (x = 0; x < _nports; x++) {
+        if (DIRTY(&_m[x])) _m[x].next = 0;    /// Start with a known state
     }
     // pack new "output" bits 
     // Switches  
-    for (int x = 0; x < getNumSwitches(); x++) { 
-        sw[x].pack();
+    for (x = 0; x < _nswitches; x++) { 
+        if (DIRTY(_sw[x].port())) _sw[x].pack();
     }
     // Signals  
-    for (int x = 0; x < getNumHeads(); x++) { 
-        head[x].pack();
+    for (x = 0; x < _nheads; x++) { 
+        if (DIRTY(_head[x].port())) _head[x].pack();
     }
     // Maintainer Call(s)
-    for (int x = 0; x < getNumCalls(); x++) { 
-        mc[x].pack();
+    for (x = 0; x < _ncalls; x++) { 
+        if (DIRTY(_mc[x].port())) _mc[x].pack();
     }
 	//Serial.("M[0]="); ControlPoint::printBin(m[0].next);Serial.println();
 	//Serial.print("M[1]="); ControlPoint::printBin(m[1].next);Serial.println();
-    for (int x = 0; x < getNumPorts(); x++) {
-        m[x].put();   // push the .next contents out to the field
+    for (x = 0; x < _nports; x++) {
+        if (DIRTY(&_m[x])) _m[x].put();   // push the .next contents out to the field
+    }
+#undef DIRTY
+    _dirtyports = 0;
+}
+
+/*
+ * Turn device changes into heads to evaluate and ports to write
+ */
+void ControlPoint::collect(void) {
+    int x;
+    boolean moved = false;
+    for (x = 0; x < _ntracks; x++) {
+        if (_track[x].changed()) {
+            _dirtyheads |= _track[x].dependents();
+            if (x < 32) bitWrite(_occupied, x, !_track[x].is(TrackCircuit::EMPTY));
+            moved = true;
+        }
+    }
+    if (moved) light();
+    for (x = 0; x < _nswitches; x++) {
+        if (_sw[x].changed()) {
+            _dirtyheads |= _sw[x].dependents();
+            markPort(_sw[x].port());
+        }
+    }
+    for (x = 0; x < _nsignals; x++) {
+        if (_sig[x].changed()) _dirtyheads |= _sig[x].dependents();
+    }
+}
+
+void ControlPoint::markPort(I2Cextender *port) {
+    if (port == NULL) {
+        bitSet(_dirtyports, CP_CALLBACKS);
+    } else if ((port >= _m) && (port - _m < CP_CALLBACKS)) {
+        bitSet(_dirtyports, port - _m);
+    } else {
+        _dirtyports |= ~0UL;	// somewhere we don't track, write them all
+    }
+}
+
+/*
+ * Work out which devices each head depends on, by looking for their names in its routes
+ *
+ * Routes are a NULL terminated PROGMEM array of PROGMEM strings; anything in
+ * them that looks like a name and matches a track circuit, switch or signal
+ * counts, whatever the syntax around it.
+ */
+void ControlPoint::dependencies(void) {
+    int x;
+    for (x = 0; x < _ntracks; x++)   { _track[x].changed(); }
+    for (x = 0; x < _nswitches; x++) { _sw[x].changed(); }
+    for (x = 0; x < _nsignals; x++)  { _sig[x].changed(); }
+    _alwaysheads = 0;
+    for (int h = 0; h < _nheads && h < CP_MAXHEADS; h++) {
+        RRSignal *s = _head[h].signal();
+        const char* const* routes = _head[h].getRoutes();
+        if (s) s->dependent(h);
+        if (!routes) {
+            if (!s) bitSet(_alwaysheads, h);
+            continue;
+        }
+        for (int r = 0; ; r++) {
+            const char *route = (const char *)pgm_read_ptr(&routes[r]);
+            if (!route) break;
+            char token[16];
+            byte n = 0;
+            for (const char *p = route; ; p++) {
+                char c = pgm_read_byte(p);
+                if (isalnum(c) || c == '_') {
+                    if (n < sizeof(token) - 1) token[n++] = c;
+                } else {
+                    if (n) {
+                        token[n] = '\0';
+                        depend(token, h);
+                        n = 0;
+                    }
+                    if (!c) break;
+                }
+            }
+        }
+    }
+}
+
+void ControlPoint::depend(char *token, byte head) {
+    int x;
+    if ((x = getTrack(token))  >= 0) _track[x].dependent(head);
+    if ((x = getSwitch(token)) >= 0) _sw[x].dependent(head);
+    if ((x = getSignal(token)) >= 0) _sig[x].dependent(head);
+}
+
+
+// approach lit heads show their aspect only while a train is on the approach
+//
+// Like _occupied, but tracks still UNKNOWN don't count: every track is,
+// until the first read(), and that is no reason to light up.  A detector
+// in ERROR might be hiding a train, so it does.
+void ControlPoint::light(void) {
+    unsigned long trains = 0;
+    for (int x = 0; x < _ntracks && x < 32; x++) {
+        if (!_track[x].is(TrackCircuit::EMPTY) && !_track[x].is(TrackCircuit::UNKNOWN)) bitSet(trains, x);
+    }
+    for (int h = 0; h < _nheads; h++) {
+        unsigned long a = _head[h].approachLit();
+        if (a) _head[h].lit((a & trains) != 0);
+    }
+}
+
+/*
+ * Turn the route strings into bitmasks, and work out which routes conflict
+ *
+ * A route conflicts with another if they share a track circuit, or need a
+ * switch they share in different positions.
+ */
+void ControlPoint::interlocking(void) {
+    int r, x;
+    _occupied = _locked = _lockedswitches = _routedsignals = 0;
+    for (x = 0; x < _ntracks && x < 32; x++) {
+        if (!_track[x].is(TrackCircuit::EMPTY)) bitSet(_occupied, x);
+    }
+    if (_nroutes > CP_MAXROUTES) _nroutes = CP_MAXROUTES;
+    for (r = 0; r < _nroutes; r++) {
+        Route *route = &_route[r];
+        char  token[16];
+        byte  n = 0;
+        char  want = 0;			// what the token after an "=" is for
+        int   which = -1;
+        route->clear();
+        for (const char *p = route->spec(); ; p++) {
+            char c = pgm_read_byte(p);
+            if (isalnum(c) || c == '_') {
+                if (n < sizeof(token) - 1) token[n++] = c;
+                continue;
+            }
+            if (n) {
+                token[n] = '\0';
+                n = 0;
+                if (want == 'S') {
+                    route->signal(which, (token[0] == 'L') ? RRSignal::LEFT : (token[0] == 'R') ? RRSignal::RIGHT : RRSignal::UNKNOWN);
+                    want = 0;
+                } else if (want == 'W') {
+                    if ((token[0] == 'N') || (token[0] == 'R')) route->add(which, token[0] == 'R');
+                    want = 0;
+                } else if (want == 'A') {
+                    if ((which = getTrack(token)) >= 0) route->approachTrack(which);
+                    want = 0;
+                } else if (!strcmp(token, "approach")) {
+                    want = 'A';
+                } else if ((which = getSignal(token)) >= 0) {
+                    want = 'S';
+                } else if ((which = getSwitch(token)) >= 0) {
+                    want = 'W';
+                } else if ((which = getTrack(token)) >= 0) {
+                    route->track(which);
+                }
+            }
+            if (!c) break;
+        }
+        if ((route->signal() < 32) && (route->direction() != RRSignal::UNKNOWN)) {
+            bitSet(_routedsignals, route->signal());
+        } else {
+            route->signal(0xFF, RRSignal::UNKNOWN);	// nothing to lock it with
+        }
+    }
+    for (r = 0; r < _nroutes; r++) {
+        for (x = 0; x < _nroutes; x++) {
+            if ((x != r) && _route[r].conflicts(&_route[x])) _route[r].conflict(x);
+        }
+    }
+}
+
+// the route from signal s towards d that the switches line up, 0xFF if none
+byte ControlPoint::lined(byte s, RRSignal::State d, unsigned long normal, unsigned long reverse) {
+    for (byte r = 0; r < _nroutes; r++) {
+        if ((_route[r].signal() == s) && (_route[r].direction() == d) && _route[r].lined(normal, reverse)) return r;
+    }
+    return 0xFF;
+}
+
+/*
+ * A locked route stays locked while its signal is cleared, while a train is
+ * in it, and while the signal runs time with a train on the approach (or for
+ * the whole running time, if the route doesn't say where the approach is).
+ */
+void ControlPoint::release(void) {
+    if (!_locked) return;
+    unsigned long was = _locked;
+    for (byte r = 0; r < _nroutes; r++) {
+        if (!bitRead(_locked, r)) continue;
+        Route    *route = &_route[r];
+        RRSignal *s     = &_sig[route->signal()];
+        if (s->is(route->direction()) || (s->target() == route->direction())) continue;
+        if (route->tracks() & _occupied) continue;
+        if (s->isRunningTime() && (!route->approach() || (route->approach() & _occupied))) continue;
+        bitClear(_locked, r);
+        TRACEEVENT(Trace::ROUTE, r, 0, route->signal());
+    }
+    if (_locked != was) lockSwitches();
+}
+
+void ControlPoint::lockSwitches(void) {
+    _lockedswitches = 0;
+    for (byte r = 0; r < _nroutes; r++) {
+        if (bitRead(_locked, r)) _lockedswitches |= _route[r].switches();
     }
 }
 
@@ -194,38 +682,302 @@ void ControlPoint::writeall(void) {
 
 int ControlPoint::getSignal(char *name) {
 	int x;
-	for (x = 0; x < getNumSignals(); x++) { 
-		if (sig[x].named(name)) break;
+	for (x = 0; x < _nsignals; x++) { 
+		if (_sig[x].named(name)) break;
 	}
-	return (x != getNumSignals()) ? x : -1;
+	return (x != _nsignals) ? x : -1;
 }
 int ControlPoint::getSwitch(char *name) {
 	int x;
-	for (x = 0; x < getNumSwitches(); x++) { if (sw[x].named(name)) break; }
-	return (x != getNumSwitches()) ? x : -1;
+	for (x = 0; x < _nswitches; x++) { if (_sw[x].named(name)) break; }
+	return (x != _nswitches) ? x : -1;
 }
 int ControlPoint::getHead(char *name) {
 	int x;
-	for (x = 0; x < getNumHeads(); x++) { if (head[x].named(name)) break; }
-	return (x != getNumHeads()) ? x : -1;    
+	for (x = 0; x < _nheads; x++) { if (_head[x].named(name)) break; }
+	return (x != _nheads) ? x : -1;    
 }
 int ControlPoint::getTrack(char *name) {
 	int x;
-	for (x = 0; x < getNumTrackCircuits(); x++) { if (track[x].named(name)) break; }
-	return (x != getNumTrackCircuits()) ? x : -1;
+	for (x = 0; x < _ntracks; x++) { if (_track[x].named(name)) break; }
+	return (x != _ntracks) ? x : -1;
+}
+
+
+
+int ControlPoint::send(int from, int to, int *indications) {
+	for (int x = 0; x < 8; x++) _lastind[x] = indications[x];
+	_sentany = 1;
+	return transmit(from, to, indications);
+}
+
+/*
+ * Aspect advertisements
+ *
+ *      ADVERTISE:  data[0] = ADVERTISE, then up to 3 pairs of (head index, aspect), 0xFF = unused
+ *      ASK:        data[0] = ASK, then up to 7 control point addresses, 0 = unused
+ */
+byte ControlPoint::advertise(void) {
+	int data[8];
+	byte n = 0;
+	byte sent = 0;
+	if (!_address) {		// nobody could tell whose aspects they were
+		TRACEEVENT(Trace::NOADDRESS, 0, ADVERTISE, 0);
+		return 0;
+	}
+	for (int h = 0; h <= _nheads; h++) {
+		if (h < _nheads) {
+			if (!_head[h].advertises() || _head[h].told()) continue;
+			_head[h].tell();
+			data[1 + 2 * n] = h;
+			data[2 + 2 * n] = _head[h].is();
+			n++;
+		}
+		if (n == 3 || (h == _nheads && n)) {
+			data[0] = ADVERTISE;
+			for (; n < 3; n++) data[1 + 2 * n] = data[2 + 2 * n] = 0xFF;
+			data[7] = 0;
+			announce(data);
+			n = 0;
+			sent++;
+		}
+	}
+	return sent;
+}
+
+void ControlPoint::heard(int src, int *data) {
+	int h;
+	if (data[0] == ADVERTISE) {
+		for (int p = 1; p < 7; p += 2) {
+			if (data[p] == 0xFF) continue;
+			for (h = 0; h < _nheads; h++) {
+				if (_head[h].follows(src, data[p]) && _head[h].nextAspect((RRSignalHead::Aspects)data[p + 1])) {
+					if (h < CP_MAXHEADS) bitSet(_dirtyheads, h);
+				}
+			}
+		}
+	} else if (data[0] == ASK) {
+		for (int p = 1; p < 8; p++) {
+			if (_address && data[p] == _address) {
+				for (h = 0; h < _nheads; h++) _head[h].untell();	// advertise() sends them all again
+			}
+		}
+	} else if (data[0] == SUBSCRIBE) {
+		if (_address && data[1] == _address && src != _address) {
+			byte masks[5];
+			for (int x = 0; x < 5; x++) masks[x] = data[3 + x];
+			enroll(src, data[2], masks, (data[2] == 0) ? 5 : 3, false);
+		}
+	} else if (data[0] == UNSUBSCRIBE) {
+		if (_address && data[1] == _address) {
+			for (int s = 0; s < CP_SUBSCRIBERS; s++) {
+				if (_subscriber[s].address == src && !_subscriber[s].direct) _subscriber[s].address = 0;
+			}
+		}
+	} else if (data[0] == RENEW) {
+		for (int l = 0; l < CP_LISTENS; l++) {
+			if (_listen[l].publisher && _listen[l].publisher == src) request(src, _listen[l].filter);
+		}
+	}
+}
+
+// tell everyone on this codeline, including the control points on this board, which won't hear it from the codeline
+void ControlPoint::announce(int *data) {
+	for (ControlPoint *cp = _first; cp; cp = cp->_next) {
+		if (cp->_codeline == _codeline) cp->heard(_address, data);
+	}
+	transmit(_address, CP_ASPECTADDRESS, data);
+}
+
+/*
+ * Indication subscriptions
+ *
+ *      SUBSCRIBE:   data[0] = SUBSCRIBE, data[1] = publisher, data[2] = first indication byte (0 or 5),
+ *                   then filter masks for bytes first...first+4 (0-4) or first...first+2 (5-7)
+ *      UNSUBSCRIBE: data[0] = UNSUBSCRIBE, data[1] = publisher
+ *      RENEW:       data[0] = RENEW, from a publisher that lost its table
+ *
+ * A subscription starting at byte 0 replaces the old filter, and a new
+ * subscriber starts from an empty one whichever half arrives first.
+ */
+boolean ControlPoint::enroll(int address, byte first, const byte *masks, byte n, boolean direct) {
+	int s, x;
+	Subscriber *sub = NULL;
+	if (!address) return false;
+	if (!_address) {
+		TRACEEVENT(Trace::NOADDRESS, address, SUBSCRIBE, 0);
+		return false;
+	}
+	for (s = 0; s < CP_SUBSCRIBERS; s++) {
+		if (_subscriber[s].address == address) { sub = &_subscriber[s]; break; }
+	}
+	boolean fresh = !sub;
+	for (s = 0; !sub && s < CP_SUBSCRIBERS; s++) {
+		if (!_subscriber[s].address) sub = &_subscriber[s];
+	}
+	if (!sub) {
+		TRACEEVENT(Trace::FULL, address, SUBSCRIBE, 0);
+		return false;
+	}
+	if (fresh || first == 0) memset(sub->filter, 0, sizeof(sub->filter));	// nothing left over from the slot's last subscriber
+	for (x = 0; x < n && first + x < 8; x++) {
+		sub->filter[first + x] = masks ? masks[x] : 0xFF;
+	}
+	sub->address = address;
+	sub->direct  = direct;
+	_sentany = 0;		// everything counts as changed for the newcomer
+	return true;
+}
+
+byte ControlPoint::subscribers(void) {
+	byte n = 0;
+	for (int s = 0; s < CP_SUBSCRIBERS; s++) {
+		if (_subscriber[s].address) n++;
+	}
+	return n;
+}
+
+boolean ControlPoint::listens(int publisher) {
+	for (int l = 0; l < CP_LISTENS; l++) {
+		if (_listen[l].publisher && _listen[l].publisher == publisher) return true;
+	}
+	return false;
+}
+
+boolean ControlPoint::subscribe(int publisher, const byte *filter) {
+	int l, free = -1;
+	if (!publisher) return false;
+	if (!_address) {		// the publisher would enroll address 0, which is nobody
+		TRACEEVENT(Trace::NOADDRESS, publisher, SUBSCRIBE, 0);
+		return false;
+	}
+	for (l = 0; l < CP_LISTENS; l++) {
+		if (_listen[l].publisher == publisher) break;
+		if (!_listen[l].publisher && free < 0) free = l;
+	}
+	if (l == CP_LISTENS) {
+		if (free < 0) {
+			TRACEEVENT(Trace::FULL, publisher, SUBSCRIBE, 1);
+			return false;
+		}
+		l = free;
+	}
+	_listen[l].publisher = publisher;
+	_listen[l].filter    = filter;
+	request(publisher, filter);
+	return true;
+}
+
+void ControlPoint::unsubscribe(int publisher) {
+	for (int l = 0; l < CP_LISTENS; l++) {
+		if (_listen[l].publisher == publisher) _listen[l].publisher = 0;
+	}
+	int data[8] = { UNSUBSCRIBE, publisher, 0, 0, 0, 0, 0, 0 };
+	announce(data);
+}
+
+void ControlPoint::request(int publisher, const byte *filter) {
+	int data[8];
+	for (int first = 0; first < 8; first += 5) {
+		data[0] = SUBSCRIBE;
+		data[1] = publisher;
+		data[2] = first;
+		for (int x = 0; x < 5; x++) {
+			data[3 + x] = (first + x < 8) ? (filter ? filter[first + x] : 0xFF) : 0;
+		}
+		announce(data);
+	}
 }
 
+// hand indications to the control points on this board that subscribed to the sender
+void ControlPoint::deliver(int src, int dst, int *data) {
+	for (ControlPoint *cp = _first; cp; cp = cp->_next) {
+		if (cp != this && cp->_codeline == _codeline && cp->listens(src)) cp->handoff(src, dst, data);
+	}
+}
 
+// queue a packet for our next receive(); never overwrites one we haven't taken yet,
+// and a burst of group indications can't crowd out the controls sent to us
+void ControlPoint::handoff(int src, int dst, int *data) {
+	PacketQueue *q = isGroup(dst) ? &_grouped : &_handoff;
+	if (!q->put(src, dst, data)) {
+#ifdef CP_STATS
+		_dropped++;
+#endif
+		TRACEEVENT(Trace::DROP, src, dst & 0xFF, (dst >> 8) & 0xFF);
+	}
+}
 
-int ControlPoint::sendCodeLine(int from, int to, int *indications) {
+/*
+ * Send the indications once to everyone who cares about a bit that moved since
+ * the last publish() or send(): the group, plus each subscriber() that only hears
+ * its own address.  Returns the number of packets sent.
+ */
+byte ControlPoint::publish(int *indications) {
+	byte changed[8];
+	byte sent = 0;
+	boolean group = false;
+	int s, x;
+	if (!_address) {		// nobody can subscribe to group(0)
+		TRACEEVENT(Trace::NOADDRESS, 0, PUBLISH, 0);
+		return 0;
+	}
+	for (x = 0; x < 8; x++) changed[x] = _sentany ? (indications[x] ^ _lastind[x]) : 0xFF;
+	for (s = 0; s < CP_SUBSCRIBERS; s++) {
+		Subscriber *sub = &_subscriber[s];
+		if (!sub->address) continue;
+		boolean cares = false;
+		for (x = 0; x < 8 && !cares; x++) cares = (sub->filter[x] & changed[x]) != 0;
+		if (!cares) continue;
+		if (sub->direct) {
+			transmit(_address, sub->address, indications);
+			sent++;
+		} else {
+			group = true;
+		}
+	}
+	if (group) {
+		deliver(_address, ControlPoint::group(_address), indications);
+		transmit(_address, ControlPoint::group(_address), indications);
+		sent++;
+	}
+	if (sent) {
+		for (x = 0; x < 8; x++) _lastind[x] = indications[x];
+		_sentany = 1;
+	}
+	return sent;
+}
+
+// ask the control points our heads follow to tell us what they show
+void ControlPoint::ask(void) {
+	int data[8];
+	byte n = 0;
+	for (int h = 0; h <= _nheads; h++) {
+		if (h < _nheads) {
+			int cp = _head[h].following();
+			if (!cp || cp == _address) continue;
+			boolean dup = false;
+			for (int x = 0; x < h && !dup; x++) dup |= (_head[x].following() == cp);	// already asked
+			if (dup) continue;
+			data[1 + n++] = cp;
+		}
+		if (n == 7 || (h == _nheads && n)) {
+			data[0] = ASK;
+			for (; n < 7; n++) data[1 + n] = 0;
+			transmit(_address, CP_ASPECTADDRESS, data);
+			n = 0;
+		}
+	}
+}
 
-	lnMsg SendPacket ;
+int ControlPoint::transmit(int from, int to, int *indications) {
+	lnMsg *SendPacket = _codeline->frame();	// build it in place in the transport's buffer
 
-	SendPacket.data[ 0 ] = OPC_PEER_XFER ;
-	SendPacket.data[ 1 ] = 0x10;                // packet length
-	SendPacket.data[ 2 ] = (from);              // SRC
-	SendPacket.data[ 3 ] =  (to & 0x7F);        // DSTL
-	SendPacket.data[ 4 ] =  (to >> 7) & 0x7F;   // DSTH 
+	SendPacket->data[ 0 ] = OPC_PEER_XFER ;
+	SendPacket->data[ 1 ] = 0x10;                // packet length
+	SendPacket->data[ 2 ] = (from);              // SRC
+	SendPacket->data[ 3 ] =  (to & 0x7F);        // DSTL
+	SendPacket->data[ 4 ] =  (to >> 7) & 0x7F;   // DSTH 
 
 	int pxct = 0x00;
 	if (indications[0] & 0x80) pxct |= B0001;
@@ -233,11 +985,11 @@ int ControlPoint::sendCodeLine(int from, int to, int *indications) {
 	if (indications[2] & 0x80) pxct |= B0100;
 	if (indications[3] & 0x80) pxct |= B1000;
 
-	SendPacket.data[ 5 ] =  pxct;    // pxct1
-	SendPacket.data[ 6 ] = indications[0] & 0x7F;  
-	SendPacket.data[ 7 ] = indications[1] & 0x7F;  
-	SendPacket.data[ 8 ] = indications[2] & 0x7F;  
-	SendPacket.data[ 9 ] = indications[3] & 0x7F;  
+	SendPacket->data[ 5 ] =  pxct;    // pxct1
+	SendPacket->data[ 6 ] = indications[0] & 0x7F;  
+	SendPacket->data[ 7 ] = indications[1] & 0x7F;  
+	SendPacket->data[ 8 ] = indications[2] & 0x7F;  
+	SendPacket->data[ 9 ] = indications[3] & 0x7F;  
 
 	pxct = 0x10;
 	if (indications[4] & 0x80) pxct |= B0001;
@@ -245,34 +997,37 @@ int ControlPoint::sendCodeLine(int from, int to, int *indications) {
 	if (indications[6] & 0x80) pxct |= B0100;
 	if (indications[7] & 0x80) pxct |= B1000;
 
-	SendPacket.data[ 10 ] = pxct;    // pxct2
-	SendPacket.data[ 11 ] = indications[4] & 0x7F;  
-	SendPacket.data[ 12 ] = indications[5] & 0x7F;  
-	SendPacket.data[ 13 ] = indications[6] & 0x7F;  
-	SendPacket.data[ 14 ] = indications[7] & 0x7F;   
+	SendPacket->data[ 10 ] = pxct;    // pxct2
+	SendPacket->data[ 11 ] = indications[4] & 0x7F;  
+	SendPacket->data[ 12 ] = indications[5] & 0x7F;  
+	SendPacket->data[ 13 ] = indications[6] & 0x7F;  
+	SendPacket->data[ 14 ] = indications[7] & 0x7F;   
 	 
     byte checksum = 0xFF; 
 	for (int i = 0; i < 15; i++) {
-      checksum ^= SendPacket.data[i];
+      checksum ^= SendPacket->data[i];
     }
-    SendPacket.data[ 15 ] = checksum; //checksum  
+    SendPacket->data[ 15 ] = checksum; //checksum  
 #ifdef LNDEBUG  
     Serial.print("Send: OPC_PEER_XFER ");
-	ControlPoint::printLnPacket(&SendPacket);
+	ControlPoint::printLnPacket(SendPacket);
 #endif
-    return (int)LocoNet.send( &SendPacket );   
+    int status = _codeline->send(SendPacket);
+    TRACEEVENT(Trace::TX, from, to & 0xFF, status);
+    return status;
 }
 
 
 #ifdef DEBUG
-void ControlPoint::printEverything(void) {
+void ControlPoint::print(void) {
 	int x;
-	Serial.println("----");
-	for (x = 0; x < getNumSignals(); x++) 		{ sig[x]  .print(); Serial.println();}
-	for (x = 0; x < getNumSwitches(); x++)		{ sw[x]   .print(); Serial.println();}
-	for (x = 0; x < getNumHeads(); x++)			{ head[x] .print(); Serial.println();}
-	for (x = 0; x < getNumTrackCircuits(); x++) { track[x].print(); Serial.println();}
-	for (x = 0; x < getNumCalls(); x++) 		{ mc[x]   .print(); Serial.println();}
+	Serial.print("---- "); Serial.println(_address, DEC);
+	for (x = 0; x < _nsignals; x++) 		{ _sig[x]  .print(); Serial.println();}
+	for (x = 0; x < _nswitches; x++)		{ _sw[x]   .print(); Serial.println();}
+	for (x = 0; x < _nheads; x++)			{ _head[x] .print(); Serial.println();}
+	for (x = 0; x < _ntracks; x++) 			{ _track[x].print(); Serial.println();}
+	for (x = 0; x < _ncalls; x++) 			{ _mc[x]   .print(); Serial.println();}
+	for (x = 0; x < _nroutes; x++) 			{ _route[x].print(); Serial.println(bitRead(_locked, x) ? "LOCKED" : "");}
 }
 
 void ControlPoint::printBin(byte x) { // 0 1 2 3 4 5 6 7
@@ -292,7 +1047,7 @@ void ControlPoint::printBinReverse(byte x) { // 7 6 5 4 3 2 1 0
     Serial.print(buff);
 }
 void ControlPoint::printBinOriginal(byte x) {
-    for (int i = 7; i >= 0; i++) {
+    for (int i = 7; i >= 0; i--) {
         if (x < pow(2, i)) {
             Serial.print(B0);
         }
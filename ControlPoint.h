@@ -6,14 +6,22 @@
 #ifndef CONTROLPOINT_H
 #define CONTROLPOINT_H
 #define DEBUG
+//#define TRACE		// binary event ring, see Trace.h - 6 bytes of RAM per TRACE_SIZE entry
+//#define CP_STATS	// throw times, refused handoffs, frames received - 11 bytes of RAM per Switch, 6 per ControlPoint
 #include <Arduino.h>
 #include <LocoNet.h>
+#include "CodeLine.h"
+#include "Capture.h"
+#include "Scheduler.h"
+#include "Lighting.h"
 
+#include "Trace.h"
 #include "TrackCircuit.h"
 #include "Switch.h"
 #include "RRSignal.h"
 #include "RRSignalHead.h"
 #include "Maintainer.h"
+#include "Route.h"
 
 
 // defined in the main sketch...
@@ -31,22 +39,277 @@ extern RRSignalHead		head[];
 extern Switch			sw[];
 extern Maintainer		mc[];
 
+/*
+ * A control point: a set of device tables, the EEPROM slot that remembers
+ * its last control packet, and its codeline address.
+ *
+ * The original static API (ControlPoint::readall() etc) drives a default
+ * instance built from the sketch's m[], track[], sw[], sig[], head[] and mc[]
+ * tables, so existing sketches don't change.  Boards (or simulations) that host
+ * several control points declare one ControlPoint per interlocking and call
+ * the instance functions instead.
+ *
+ * Control points sharing one codeline each get a distinct address; a packet
+ * received by one of them that is addressed to another is handed over.  An
+ * address of 0 accepts everything, and leaves the filtering to the sketch.
+ *
+ * codeline(line) moves this control point off the LocoNet library onto another
+ * CodeLine transport (see CodeLine.h) - a queue, a pty, a socket, a simulated bus.
+ *
+ * Evaluation is event driven: begin() reads each head's route strings and
+ * notes which TrackCircuits, Switches and RRSignals it mentions.  When one of
+ * those changes (input, dispatcher, or timer), only the heads that depend on
+ * it are handed to the sketch's evaluation function, and write() only repacks
+ * and writes the ports whose outputs actually changed.  An idle scan then
+ * costs little more than reading the inputs.
+ *
+ *      void evaluate(int h) { head[h].set(...walk head[h]'s routes...); }
+ *      loop() { ...  ControlPoint::readall(); ControlPoint::evaluateall(evaluate); ControlPoint::writeall(); }
+ *
+ * Dependencies are tracked for the first CP_MAXHEADS heads; any beyond that,
+ * and heads with neither routes nor a signal, are evaluated every time.
+ *
+ * apply(controls) takes a whole control packet at once: every Switch and
+ * RRSignal given its bits with controls(...) at setup is checked against the
+ * packet, and either all of the requested changes are made or none are.
+ * A device whose bits are all 0 is left alone.  The result is 0 (ACCEPTED)
+ * or a mask of the Refusal reasons.
+ *
+ *      sw[0].controls(0, 1);  sig[0].controls(2, 3);        // in setup()
+ *      if (ControlPoint::applyControls(controls) == ControlPoint::ACCEPTED) ControlPoint::savestate(controls);
+ *
+ * With a route table (see Route.h), apply() also does route locking.  A
+ * signal may only be cleared over a route that is lined by the switches,
+ * is clear of trains and doesn't conflict with a locked route; the route is
+ * then locked, and the packet refused (LOCKED) if it would move any of its
+ * switches.  The lock is released once the signal is back at stop, the
+ * route's tracks are empty and any running time with a train on the
+ * approach is over.  All of this is a few ANDs of bitmasks - the route's,
+ * against the occupied tracks and the locked routes and switches - which
+ * begin() works out from the route strings and read() keeps up to date.
+ *
+ *      ControlPoint::routeTable(route, 4);     // in setup(), before ControlPoint::setup()
+ *
+ * Signals without routes are not route locked.  Switch::sig() and
+ * Switch::trk() add signal and detector locking for a single switch.
+ *
+ * Heads given approachLit(track) tracks are kept dark until one of them is
+ * OCCUPIED or in ERROR - not UNKNOWN, as every track is before the first
+ * read(); write() only touches them when that changes.
+ *
+ * Maintainer calls are decoded the same way, but are not vital and are
+ * set whether or not the rest of the packet is accepted.
+ *
+ * indications(ind, changed) builds the indication packet the same way, from the
+ * bits given to Switch/RRSignal::indications(...) and TrackCircuit::indication(bit),
+ * and says which bits moved since the last send():
+ *
+ *      int ind[8], changed[8];
+ *      if (ControlPoint::buildIndications(ind, changed)) ControlPoint::sendCodeLine(me, office, ind);
+ *
+ * APPROACH and ADVANCED_APPROACH depend on the next signal, which is usually in
+ * the next control point.  Exit heads are marked with advertise(true), and
+ * advertise() sends their aspects to CP_ASPECTADDRESS - only the ones that
+ * changed, up to 3 per packet.  A head that follow()s one of them (by control
+ * point address and head index) hears about it in receive(), gets re-evaluated,
+ * and its CLEAR becomes APPROACH or ADVANCED_APPROACH as needed.  Until it
+ * hears, a follower assumes the next signal is at STOP.  begin() asks the
+ * control points being followed to advertise everything once.  Followers
+ * know an advertisement by its source, so a control point needs a codeline
+ * address to advertise - advertise() from address 0 ("any") sends nothing
+ * and traces NOADDRESS.  The default control point gets its address from
+ * setup(address).
+ *
+ *      head[1].advertise(true);  head[0].follow(12, 1);      // in setup()
+ *      ControlPoint::setup(11);
+ *      ...evaluateall(evaluate); writeall(); ControlPoint::advertiseAspects();
+ *
+ * A change only moves the heads up to two signals back (STOP -> APPROACH ->
+ * ADVANCED_APPROACH -> CLEAR), so a train passing a signal settles in at most
+ * two more advertisements in each direction.
+ *
+ * When several listeners want the same indications - the office, a local
+ * panel, the neighbouring control points - publish() sends them once, to
+ * this control point's group address, group(address()), instead of once per
+ * listener.  Listeners on the codeline ask for them with subscribe(), which
+ * sends a SUBSCRIBE on CP_ASPECTADDRESS; receive() then hands back packets
+ * from that publisher's group with *dst set to the group.  A listener that
+ * only hears its own address, like an office that predates this, is added
+ * at the publisher with subscriber() and gets its own copy.  Each subscriber
+ * can give a filter - 8 bytes, a 1 for each indication bit it cares about,
+ * NULL for all - and nothing is sent when the only bits that moved are ones
+ * nobody cares about.  A new subscriber gets everything on the next publish().
+ * begin() asks the listeners to subscribe again, so a publisher that was
+ * reset gets its table back.  Subscriptions go by address at both ends, so
+ * subscribe(), subscriber() and publish() on a control point at address 0
+ * refuse - false, or 0 packets - and trace NOADDRESS.
+ *
+ *      ControlPoint::setup(11);                           // in setup(), at the listener
+ *      ControlPoint::subscribeTo(12, NULL);
+ *      if (ControlPoint::buildIndications(ind, changed)) ControlPoint::publishIndications(ind);
+ *      ...
+ *      if (ControlPoint::LnPacket2Controls(&src, &dst, data) == 1 && ControlPoint::isGroup(dst)) ...src's indications
+ */
+#define CP_MAXHEADS  32
+#define CP_MAXROUTES 32
+#define CP_CALLBACKS 31				// _dirtyports bit for devices driven by callbacks
+
+#define CP_EEPROM_SLOTSIZE	20		// bytes of EEPROM per control point
+
+#define CP_PERSISTIDLE		0xFF
+
+#ifndef CP_HANDOFF
+#define CP_HANDOFF			1		// per queue, 2 queues per control point, 12 bytes of RAM each
+#endif
+
+#define CP_ASPECTADDRESS	0x3FFF	// codeline address aspect advertisements are sent to
+#define CP_GROUPADDRESS		0x2000	// | a control point's address = where it publish()es
+
+/*
+ * Table sizes, per control point.  The defaults cover an office and a panel;
+ * a subscriber or publisher past the end is refused and traced as FULL.
+ * Change them with -D for the whole build, library included - a #define in
+ * the sketch is never seen by ControlPoint.cpp.
+ */
+#ifndef CP_SUBSCRIBERS
+#define CP_SUBSCRIBERS		2		// 11 bytes of RAM each
+#endif
+#ifndef CP_LISTENS
+#define CP_LISTENS			2		// publishers subscribed to, 4 bytes of RAM each
+#endif
+
+/*
+ * Packets one control point picked up off a shared codeline for another
+ * one on the same board, waiting for that one's receive().  Controls and
+ * group indications get a queue each, and receive() takes controls first.
+ * When a queue is full the new packet is refused - traced, and with CP_STATS
+ * counted in dropped() - rather than overwriting one that hasn't been acted on
+ * yet.  One each is enough unless the board's control points are slow to call
+ * receive().
+ */
+class PacketQueue {
+public:
+	PacketQueue(void)                    { clear(); };
+	void    clear(void)                  { _head = _count = 0; };
+	boolean full(void)                   { return _count == CP_HANDOFF; };
+	byte    count(void)                  { return _count; };
+	boolean put(int src, int dst, int *data) {
+		if (full()) return false;
+		Packet *p = &_q[_head];
+		p->src = src;
+		p->dst = dst;
+		for (int x = 0; x < 8; x++) p->data[x] = data[x];
+		_head = (_head + 1) % CP_HANDOFF;
+		_count++;
+		return true;
+	};
+	boolean get(int *src, int *dst, int *data) {
+		if (!_count) return false;
+		Packet *p = &_q[(_head + CP_HANDOFF - _count) % CP_HANDOFF];
+		*src = p->src;
+		*dst = p->dst;
+		for (int x = 0; x < 8; x++) data[x] = p->data[x];
+		_count--;
+		return true;
+	};
+private:
+	struct Packet {
+		int  src;
+		int  dst;
+		byte data[8];
+	};
+	Packet _q[CP_HANDOFF];
+	byte   _head;
+	byte   _count;
+};
+
 class ControlPoint {
 public:
-	//static RRSignalHead::Aspects Evaluate(char *input);
-	//static RRSignalHead::Aspects mostRestrictive(RRSignalHead::Aspects current, RRSignalHead::Aspects desired);
+	enum Refusal { ACCEPTED = 0, BADSWITCH = 1, SIGNALNOTSTOP = 2, LOCKED = 4 };
+
+	ControlPoint(void)                 { _init(0, 0); };
+	~ControlPoint(void);
+	ControlPoint(int address, int slot, 
+	             I2Cextender  *ports,  int nports,
+	             TrackCircuit *tracks, int ntracks,
+	             Switch       *sws,    int nswitches,
+	             RRSignal     *sigs,   int nsignals,
+	             RRSignalHead *heads,  int nheads,
+	             Maintainer   *calls,  int ncalls) {
+		_init(address, slot);
+		tables(ports, nports, tracks, ntracks, sws, nswitches, sigs, nsignals, heads, nheads, calls, ncalls);
+	};
+	void tables(I2Cextender  *ports,  int nports,
+	            TrackCircuit *tracks, int ntracks,
+	            Switch       *sws,    int nswitches,
+	            RRSignal     *sigs,   int nsignals,
+	            RRSignalHead *heads,  int nheads,
+	            Maintainer   *calls,  int ncalls);
+
+	void                     begin(void);
+	boolean                  read(void);
+	void                     write(void);
+	void                     evaluate(void (*fn)(int head));
+	byte                     apply(int *controls);
+	byte                     indications(int *ind, int *changed);
+	unsigned long            dirty(void)                              { collect(); return _dirtyheads | _alwaysheads; };
+	int                      receive(int *src, int *dst, int *controls);
+	int                      send(int to, int *indications)           { return send(_address, to, indications); };
+	int                      send(int from, int to, int *indications);
+	byte                     advertise(void);
+	byte                     publish(int *indications);				// packets sent
+	boolean                  subscriber(int address, const byte *filter) { return enroll(address, 0, filter, 8, true); };
+	boolean                  subscribe(int publisher, const byte *filter);
+	void                     unsubscribe(int publisher);
+	byte                     subscribers(void);
+	boolean                  listens(int publisher);
+	void                     save(int *controls);
+	void                     saveLater(int *controls);			// save() a byte at a time...
+	boolean                  persist(void);						// ...one per call, true while there's more
+	void                     restore(void);
+	void                     routes(Route *routes, int nroutes)       { _route = routes; _nroutes = nroutes; };
+	Route                   *route(int r)                             { return (r < _nroutes) ? &_route[r] : NULL; };
+	unsigned long            locked(void)                             { return _locked; };		// bit per route
+	unsigned long            occupied(void)                           { return _occupied; };	// bit per track
+	void                     codeline(CodeLine *line)                 { _codeline = line ? line : &LocoNetLine; };
+	CodeLine                *codeline(void)                           { return _codeline; };
+	int                      address(void)                            { return _address; };
+	void                     address(int address)                     { _address = address; };	// before begin()
+#ifdef CP_STATS
+	unsigned int             dropped(void)                            { return _dropped; };		// handed-off packets refused
+	unsigned long            frames(void)                             { return _frames; };		// taken off the codeline by receive()
+#endif
+	int                      slot(void)                               { return _slot; };
+#ifdef DEBUG
+	void                     print(void);
+#endif
+
+	// The default, sketch defined control point...
+	static ControlPoint     &defaultCP(void);
 	static void 			 initializeCodeLine(int lnrx, int lntx);
-	static int               sendCodeLine(int from, int to, int *indications);
-	static boolean           readall(void);
-	static void              writeall(void);	
-	static int               LnPacket2Controls(int *src, int *dst, int *controls);
+	static int               sendCodeLine(int from, int to, int *indications) { return defaultCP().send(from, to, indications); };
+	static boolean           readall(void)                                    { return defaultCP().read(); };
+	static void              writeall(void)                                   { defaultCP().write(); };
+	static void              evaluateall(void (*fn)(int head))                { defaultCP().evaluate(fn); };
+	static byte              applyControls(int *controls)                     { return defaultCP().apply(controls); };
+	static byte              buildIndications(int *ind, int *changed)         { return defaultCP().indications(ind, changed); };
+	static int               LnPacket2Controls(int *src, int *dst, int *controls) { return defaultCP().receive(src, dst, controls); };
 	static int               freeRam (void);
-	static void              setup(void);
-	static void              savestate(int *controls);
-	static void              restorestate(void);
+	static void              setup(void)                                      { defaultCP().begin(); };
+	static void              setup(int address)                               { defaultCP().address(address); defaultCP().begin(); };
+	static void              savestate(int *controls)                         { defaultCP().save(controls); };
+	static void              restorestate(void)                               { defaultCP().restore(); };
+	static void              savestateLater(int *controls)                    { defaultCP().saveLater(controls); };
+	static boolean           persiststate(void)                               { return defaultCP().persist(); };
+	static byte              advertiseAspects(void)                           { return defaultCP().advertise(); };
+	static void              routeTable(Route *routes, int nroutes)           { defaultCP().routes(routes, nroutes); };
+	static byte              publishIndications(int *indications)             { return defaultCP().publish(indications); };
+	static boolean           subscribeTo(int publisher, const byte *filter)   { return defaultCP().subscribe(publisher, filter); };
+	static int               group(int address)                               { return CP_GROUPADDRESS | address; };
+	static boolean           isGroup(int dst)                                 { return (dst & CP_GROUPADDRESS) && dst != CP_ASPECTADDRESS; };
 	
 #ifdef DEBUG
-	static void              printEverything(void);	
+	static void              printEverything(void)                            { defaultCP().print(); };
 	static void              printControls(int from, int to, int *controls);
 	static void              printIndications(int from, int to, int *indications);
 	static void              printPacket(char *name, int from, int to, int *packet);	
@@ -56,15 +319,112 @@ public:
 	static void              printBinOriginal(byte x);	
 #endif
 private:
-	static int						getSignal(char *name);
-	static int						getSwitch(char *name);
-	static int						getHead(char *name);
-	static int						getTrack(char *name);
-	static RRSignalHead::Aspects	A_Switch(char *name, char *token);
-	static RRSignalHead::Aspects	A_Signal(char *name, char *token);
-	static RRSignalHead::Aspects	A_Approach(char *name, char *token);
-	static RRSignalHead::Aspects	A_Track(char *name, char*token);
-	
+	void _init(int address, int slot) {
+		_address       = address;
+		_slot          = slot;
+		_usesavedstate = 0;
+#ifdef CP_STATS
+		_dropped       = 0;
+		_frames        = 0;
+#endif
+		_dirtyheads    = _alwaysheads = _dirtyports = 0;
+		_sentany       = 0;
+		_persiststep   = CP_PERSISTIDLE;
+		_codeline      = &LocoNetLine;
+		_route         = NULL;
+		_nroutes       = 0;
+		_occupied      = _locked = _lockedswitches = _routedsignals = 0;
+		memset(_subscriber, 0, sizeof(_subscriber));
+		memset(_listen, 0, sizeof(_listen));
+		tables(NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+		_next          = _first;		// remember everyone, for packet handoff
+		_first         = this;
+	};
+	void                            collect(void);
+	void                            dependencies(void);
+	void                            depend(char *token, byte head);
+	void                            markPort(I2Cextender *port);
+	void                            interlocking(void);
+	byte                            lined(byte signal, RRSignal::State d, unsigned long normal, unsigned long reverse);
+	void                            release(void);
+	void                            lockSwitches(void);
+	void                            light(void);
+	void                            unpackPacket(lnMsg *LnPacket, int *src, int *dst, int *controls);
+	int                             transmit(int from, int to, int *data);
+	void                            heard(int src, int *data);
+	void                            ask(void);
+	void                            announce(int *data);
+	boolean                         enroll(int address, byte first, const byte *masks, byte n, boolean direct);
+	void                            request(int publisher, const byte *filter);
+	void                            deliver(int src, int dst, int *data);
+	void                            handoff(int src, int dst, int *data);
+	enum                            AspectMessage { ADVERTISE = 0, ASK = 1, SUBSCRIBE = 2, UNSUBSCRIBE = 3, RENEW = 4,
+	                                                PUBLISH = 5 };	// PUBLISH is never sent, it only names publish() in a trace
+	int								getSignal(char *name);
+	int								getSwitch(char *name);
+	int								getHead(char *name);
+	int								getTrack(char *name);
+	RRSignalHead::Aspects	A_Switch(char *name, char *token);
+	RRSignalHead::Aspects	A_Signal(char *name, char *token);
+	RRSignalHead::Aspects	A_Approach(char *name, char *token);
+	RRSignalHead::Aspects	A_Track(char *name, char*token);
+
+	int            _address;		// codeline address, 0 = any
+	int            _slot;			// EEPROM slot
+	I2Cextender   *_m;
+	TrackCircuit  *_track;
+	Switch        *_sw;
+	RRSignal      *_sig;
+	RRSignalHead  *_head;
+	Maintainer    *_mc;
+	byte           _nports;
+	byte           _ntracks;
+	byte           _nswitches;
+	byte           _nsignals;
+	byte           _nheads;
+	byte           _ncalls;
+
+	byte           _savedcontrols[8];
+	byte           _usesavedstate;
+	byte           _persistcontrols[8];	// waiting to be written by persist()
+	byte           _persiststep;
+	PacketQueue    _handoff;		// packets for us, received by someone else
+	PacketQueue    _grouped;		// group indications we subscribed to, ditto
+#ifdef CP_STATS
+	unsigned int   _dropped;
+	unsigned long  _frames;
+#endif
+
+	byte           _lastind[8];		// what the last send() sent
+	byte           _sentany;
+
+	unsigned long  _dirtyheads;		// need evaluating
+	unsigned long  _alwaysheads;	// no idea what they depend on
+	unsigned long  _dirtyports;		// bit per port, plus CP_CALLBACKS
+
+	CodeLine      *_codeline;
+
+	Route         *_route;
+	byte           _nroutes;
+	unsigned long  _occupied;		// bit per track, anything but EMPTY
+	unsigned long  _locked;			// bit per route
+	unsigned long  _lockedswitches;	// bit per switch, in a locked route
+	unsigned long  _routedsignals;	// bit per signal, has routes
+
+	struct Subscriber {
+		int        address;			// 0 = unused
+		byte       filter[8];		// indication bits it wants
+		boolean    direct;			// only hears its own address
+	};
+	Subscriber     _subscriber[CP_SUBSCRIBERS];
+	struct Listen {
+		int        publisher;		// 0 = unused
+		const byte *filter;
+	};
+	Listen         _listen[CP_LISTENS];
+
+	ControlPoint  *_next;
+	static ControlPoint *_first;
 };
   
 
@@ -0,0 +1,106 @@
+/*
+ * Room and layout lighting
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include <ControlPoint.h>		// for DEBUG
+#include "Lighting.h"
+
+// fraction of the way from the old level to the new one (0-255), every 1/16th of the fade
+static const byte linearCurve[LIGHT_CURVEPOINTS] PROGMEM = {
+	  0,  16,  32,  48,  64,  80,  96, 112, 128, 143, 159, 175, 191, 207, 223, 239, 255 };
+static const byte easeCurve[LIGHT_CURVEPOINTS] PROGMEM = {		// slow start and finish
+	  0,   2,  10,  21,  37,  56,  77, 101, 128, 154, 178, 199, 218, 234, 245, 253, 255 };
+static const byte gammaCurve[LIGHT_CURVEPOINTS] PROGMEM = {		// looks even to the eye on LEDs
+	  0,   1,   4,   9,  16,  25,  36,  49,  64,  81, 100, 121, 144, 169, 196, 225, 255 };
+static const byte flickerCurve[LIGHT_CURVEPOINTS] PROGMEM = {	// fluorescent tubes striking
+	  0, 180,  20, 200,   0,  90, 230,  40,   0, 255,  60, 255, 120, 255, 255, 255, 255 };
+
+const byte *Lighting::curve(byte c) {
+	switch (c) {
+	case EASE:    return easeCurve;
+	case GAMMA:   return gammaCurve;
+	case FLICKER: return flickerCurve;
+	default:      return linearCurve;
+	}
+}
+
+void Lighting::scene(const LightStep *steps, byte nsteps, unsigned long period) {
+	_steps     = steps;
+	_nsteps    = nsteps;
+	_step      = 0;
+	_period    = period;
+	_sceneTime = 0;
+}
+
+void Lighting::markPort(I2Cextender *port) {
+	for (byte x = 0; x < _ndirty; x++) {
+		if (_dirty[x] == port) return;
+	}
+	if (_ndirty < sizeof(_dirty) / sizeof(_dirty[0])) {
+		_dirty[_ndirty++] = port;
+	} else {
+		port->put();		// table full, write it now
+	}
+}
+
+boolean Lighting::run(unsigned int budget) {
+	unsigned long start = micros();
+	boolean out = false;		// ran out of budget
+	boolean busy = false;
+	_ndirty = 0;
+
+	// scene steps that have come due
+	while (_steps) {
+		if (_step == _nsteps) {
+			if (!_period) { _steps = NULL; break; }
+			if ((unsigned long)_sceneTime < _period) { _sceneTime.deadline(_period); break; }
+			_sceneTime = (unsigned long)_sceneTime - _period;
+			_step = 0;
+			continue;
+		}
+		LightStep s;
+		memcpy_P(&s, &_steps[_step], sizeof(s));
+		if ((unsigned long)_sceneTime < s.at) { _sceneTime.deadline(s.at); break; }
+		if (s.light < _nlights) _lights[s.light].fade(s.level, s.fade, s.curve);
+		_step++;
+		if (budget && (micros() - start > budget)) { out = true; break; }
+	}
+
+	// fades, starting with whoever was cut off last time
+	for (byte n = 0; n < _nlights && !out; n++) {
+		Light *l = &_lights[_next];
+		_next = (_next + 1) % _nlights;
+		if (!l->fading()) continue;
+		if (l->update(curve(l->curve()))) {
+			l->pack();
+			if (l->port()) markPort(l->port());
+		}
+		if (l->fading()) busy = true;
+		if (budget && (micros() - start > budget)) out = true;
+	}
+
+	for (byte x = 0; x < _ndirty; x++) {
+		_dirty[x]->put();
+	}
+	if (out) {
+		_short++;
+		busy = true;
+	}
+	return busy;
+}
+
+#ifdef DEBUG
+void Lighting::print(void) {
+	for (byte x = 0; x < _nlights; x++) {
+		_lights[x].print();
+		Serial.println();
+	}
+	Serial.print("scene step "); Serial.print(_step);
+	Serial.print(" of ");        Serial.print(_nsteps);
+	Serial.print(" short runs ");  Serial.println(_short);
+}
+#endif
@@ -0,0 +1,179 @@
+/*
+ *    Room and layout lighting
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef LIGHTING_H
+#define LIGHTING_H
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <I2Cextender.h>
+#include "Clock.h"
+
+/*
+ * A light: a PWM pin, an I2Cextender bit (on at half brightness and up), or
+ * a callback, faded from one level (0-255) to another along a curve.
+ *
+ *      Light room[] = { Light("YARD", 5), Light("DEPOT", 6), Light("TOWER", &m[2], 0) };
+ *      room[0].fade(255, 3000, Lighting::EASE);      // up over 3 seconds
+ *
+ * Curves are 17 point PROGMEM tables (see Lighting.cpp) of how far along
+ * the fade the brightness is, sampled every 1/16th of the fade's time.
+ */
+#define LIGHT_CURVEPOINTS	17
+#define LIGHT_STEPMS		20		// how often a fading light wants updating
+
+class Light {
+public:
+	Light(const char *name, byte pin)                                  { _init(name, NULL, NULL, 0, pin); };
+	Light(const char *name, I2Cextender *m, int bitpos)                { _init(name, NULL, m, bitpos, 0xFF); };
+	Light(const char *name, void (*setFunction)(const char *, byte))   { _init(name, setFunction, NULL, 0, 0xFF); };
+
+	void    fade(byte level, unsigned int ms, byte curve) {
+	                                    _from = _level; _to = level; _curve = curve;
+	                                    _time = 0; _duration = ms; _fading = true;
+	                                  };
+	void    fade(byte level, unsigned int ms)   { fade(level, ms, 0); };
+	void    set(byte level)           { fade(level, 0, 0); };
+	byte    is(void)                  { return _level; };		// what the output shows now
+	byte    target(void)              { return _to; };
+	boolean fading(void)              { return _fading; };
+
+	// move the fade along; true if the output needs writing
+	boolean update(const byte *curve) {
+		if (!_fading) return false;
+		unsigned long t = _time;
+		byte level;
+		if (t >= _duration) {
+			level   = _to;
+			_fading = false;
+		} else {
+			// 16 segments of 4096 steps each
+			unsigned long p   = (t << 16) / _duration;
+			byte          seg = p >> 12;
+			int           a   = pgm_read_byte(&curve[seg]);
+			int           b   = pgm_read_byte(&curve[seg + 1]);
+			int           f   = a + (((long)(b - a) * (long)(p & 0xFFF)) >> 12);
+			level = _from + (((long)((int)_to - (int)_from) * f) / 255);
+			_time.deadline(t + LIGHT_STEPMS);
+		}
+		if (level == _level) return false;
+		_level = level;
+		return true;
+	}
+
+	// push the current level out to the field
+	void pack(void) {
+		if (_setLevel) {
+			_setLevel(_name, _level);
+		} else if (_m) {
+			bitWrite((*_m).next, _bitpos, _level >= 128);
+		} else if (_pin != 0xFF) {
+			analogWrite(_pin, _level);
+		}
+	}
+	I2Cextender *port(void)           { return _m; };
+	byte    curve(void)               { return _curve; };
+	boolean named(char *n)            { return strcmp(n, _name) == 0; };
+	const char *name(void)            { return _name; };
+	void print(void)                  {
+	                                    for (int x = 7 - strlen(_name); x > 0; x--) { Serial.print(" "); }
+	                                    Serial.print(_name); Serial.print(":");
+	                                    Serial.print(_level);
+	                                    if (_fading) { Serial.print(" -> "); Serial.print(_to); }
+	                                  };
+private:
+	void _init(const char *name, void (*setFunction)(const char *, byte), I2Cextender *m, int bitpos, byte pin) {
+		_name     = name;
+		_setLevel = setFunction;
+		_m        = m;
+		_bitpos   = bitpos;
+		_pin      = pin;
+		_level    = _from = _to = 0;
+		_curve    = 0;
+		_duration = 0;
+		_fading   = false;
+	};
+
+	const char   *_name;
+	void        (*_setLevel)(const char *, byte);
+	I2Cextender  *_m;
+	int           _bitpos;
+	byte          _pin;
+	byte          _level;
+	byte          _from;
+	byte          _to;
+	byte          _curve;
+	boolean       _fading;
+	unsigned int  _duration;		// ms
+	ElapsedTime   _time;
+};
+
+/*
+ * A step in a scene: "at" ms into the scene, fade light to level over fade ms.
+ * Steps go in PROGMEM, in time order:
+ *
+ *      const LightStep day[] PROGMEM = {
+ *          {      0, 0, 255, 60000, Lighting::EASE },     // sunrise over the yard
+ *          { 600000, 0,   0, 60000, Lighting::EASE },     // and sunset 10 minutes later
+ *      };
+ */
+struct LightStep {
+	unsigned long at;
+	byte          light;		// index in the Lighting's table
+	byte          level;
+	unsigned int  fade;
+	byte          curve;
+};
+
+/*
+ * Runs a table of lights and, optionally, a scene.  run(budget) does as
+ * much as it can in budget microseconds - due scene steps first, then
+ * fades, taking turns so that each light gets its share - and picks up
+ * where it left off on the next call.  Give it its own Scheduler task so
+ * a busy fade never delays the vital ones:
+ *
+ *      Lighting lights(room, 3);
+ *      void lighting(void) { lights.run(300); }
+ *
+ *      setup() { ...  lights.scene(day, 2, 1440000UL);  tasks.every(20, lighting); }
+ *
+ * A scene with a period starts again from the top every period ms - a
+ * 24 minute fast clock day, say.  Lights on I2Cextender ports need ports
+ * of their own: ControlPoint::write() starts each port it writes from 0.
+ */
+class Lighting {
+public:
+	enum Curve { LINEAR, EASE, GAMMA, FLICKER };
+
+	Lighting(Light *lights, byte nlights)              { _lights = lights; _nlights = nlights; _next = 0;
+	                                                     _steps = NULL; _nsteps = _step = 0; _period = 0; _short = 0; };
+	void    scene(const LightStep *steps, byte nsteps, unsigned long period);	// steps in PROGMEM
+	void    stop(void)                                 { _steps = NULL; };
+	boolean run(unsigned int budget);		// true while anything is fading
+	unsigned int shortRuns(void)                       { return _short; };	// runs that ran out of budget
+	static const byte *curve(byte c);
+#ifdef DEBUG
+	void    print(void);
+#endif
+
+private:
+	void    markPort(I2Cextender *port);
+
+	Light            *_lights;
+	byte              _nlights;
+	byte              _next;		// whose turn it is
+	const LightStep  *_steps;
+	byte              _nsteps;
+	byte              _step;		// next step due
+	unsigned long     _period;		// ms, 0 = play once
+	ElapsedTime       _sceneTime;
+	unsigned int      _short;
+	I2Cextender      *_dirty[4];	// ports to put() at the end of this run
+	byte              _ndirty;
+};
+
+#endif
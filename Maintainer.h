@@ -31,11 +31,16 @@ public:
 									}
 								}
 
-    void   set(State s)         { _commanded = s; };
-    void   set(int n)           { _commanded = (((n) == 1) ? Maintainer::ON  :
-											    ((n) == 0) ? Maintainer::OFF :   
-															 Maintainer::ERROR);
+    void   set(State s)         { if (_commanded != s) { _commanded = s; _changed = true; } };
+    void   set(int n)           { set(((n) == 1) ? Maintainer::ON  :
+								      ((n) == 0) ? Maintainer::OFF :   
+												   Maintainer::ERROR);
     }
+	I2Cextender *port(void)     { return _m; };
+	// where the call request bit is in a control packet, 0-63
+	void   controls(int bit)    { _ctl = bit; };
+	void   fromControls(int *controls) { if (_ctl != 0xFF) set(CTLBIT(controls, _ctl)); };
+	boolean changed(void)       { boolean c = _changed; _changed = false; return c; };	// since last asked
     boolean named(char *n)      { return strcmp(n, _name) == 0; }
     void print(void)            {
 	 									const char *s;
@@ -58,10 +63,14 @@ private:
 		_m = m;
 		_bitpos = bitpos;
 		_commanded = Maintainer::UNKNOWN;
+		_changed = true;
+		_ctl = 0xFF;
 	};
     
     const char *_name;
     State _commanded;
+	boolean _changed;
+	byte    _ctl;
 	I2Cextender *_m;
 	int         _bitpos;
 	void (*_setFunction)(const char*, State);
@@ -9,9 +9,10 @@
 #ifndef RRSIGNAL_H
 #define RRSIGNAL_H
 #include <Arduino.h>
-#include <elapsedMillis.h>
+#include "Clock.h"
 #include <ControlPoint.h>
 #include <SPCoast.h>
+#include "Trace.h"
 
 class RRSignal {
 public:
@@ -27,29 +28,47 @@ public:
 
     boolean is(State s)               { return (_reported == s); };
     boolean isSafe(State s)           { if (s  == _reported) { return true; }
-                                        if (!is(RRSignal::ALLSTOP)) { return false; }
+                                        if (!check(s)) { return false; }
 										_safestate = s;
 										return true;
                                       };
     boolean isSafe(int n, int r)      { return isSafe(toState(n,r)); }
 	void  doSafe(void)				  { if (_safestate != UNKNOWN) { set(_safestate); _safestate = UNKNOWN; } }
+	void  abortSafe(void)             { _safestate = UNKNOWN; }		// another device refused, forget it
+	boolean check(State s)            { return (s == RRSignal::ALLSTOP) || (s == _reported) || is(RRSignal::ALLSTOP); }	// isSafe without remembering anything; stop is always safe
+
+	// where this signal's L and R request bits are in a control packet, 0-63 (see ControlPoint::apply)
+	void  controls(int bitL, int bitR) { _ctlL = bitL; _ctlR = bitR; }
+	boolean hasControls(void)         { return _ctlL != 0xFF; }
+	byte  controlL(void)              { return _ctlL; }
+	byte  controlR(void)              { return _ctlR; }
+	State fromControls(int *controls) { return toState(CTLBIT(controls, _ctlL), CTLBIT(controls, _ctlR)); }
+	// and where its K#SG / K#NG indications go
+	void  indications(int bitL, int bitR) { _indL = bitL; _indR = bitR; }
+	void  indicate(int *ind)          { if (_indL != 0xFF) PUTBIT(ind, _indL, leftindication());
+	                                    if (_indR != 0xFF) PUTBIT(ind, _indR, rightindication()); }
 
     boolean commanded(State s)        { return (_commanded == s); };
     State commanded(void)             { return _commanded;};
+    State target(void)                { return (_commanded == TIME) ? _nextcommanded : _commanded; };	// where it ends up after running time
     void set(State s)                 { if (_commanded == s)                      { /* NO OP */ }
-	                                    else if (_commanded == RRSignal::ALLSTOP) {  _commanded = s;}
+	                                    else if (_commanded == RRSignal::ALLSTOP) {  TRACEEVENT(Trace::SIGNAL, _id, _commanded, s); _commanded = s; _changed = true;}
 									    else                                      { setTime(10, s); }
 									  };
     void set(int n, int r)            { set(toState(n,r)); };
     
 	boolean knockdown(void)           { if ((_reported != RRSignal::ALLSTOP) && (_commanded != RRSignal::ALLSTOP)) {
+											TRACEEVENT(Trace::KNOCKDOWN, _id, _reported, _commanded);
 											_wascommanded = _commanded;        // FLEET triggers off of this...
 											_reported     = RRSignal::ALLSTOP;
+											_changed      = true;
 											return true;
 										}
 										return false;
 									  }    
-    void report(void)                 { _reported = _commanded; }
+    void report(void)                 { if (_reported != _commanded) { TRACEEVENT(Trace::SIGNAL, _id, _reported, _commanded); _changed = true; }
+	                                    _reported = _commanded; 
+									  }
     State reported(void)              { return _reported;};  // differs when running time
     State toState(int l, int r)       { return (
                                             (((l) == 1) && ((r) == 0)) ? RRSignal::LEFT :
@@ -68,28 +87,34 @@ public:
                                             _time2end = (seconds *1000); 
                                             _timer = RRSignal::RUNNING;
                                             _nextcommanded = s;
+                                            TRACEEVENT(Trace::TIME, _id, seconds, s);
+                                            _changed = true;
                                             _commanded = TIME; // knock it down now, but don't let the plant change for xxx seconds...
                                       }
     Timer runTime(void)               {
                                         if (isRunningTime()) {
                                             if (_delaytime > _time2end) { // timer expired
                                                 _timer = RRSignal::EXPIRED;
+                                            } else {
+                                                _delaytime.deadline(_time2end + 1);
                                             }
                                         } 
                                         if (_timer == RRSignal::EXPIRED) {
+                                          TRACEEVENT(Trace::TIME, _id, 0, _nextcommanded);
                                           _commanded    = _nextcommanded;  
                                           _time2end     = 0;
                                           _timer = RRSignal::NOTIMER;
+                                          _changed = true;
                                         }  
                                         return _timer;  
                                       }
     
     Stick stick(void)                 { return _stick;};
-    void stick(Stick s)               { _stick = s; };
-    boolean isStick(Stick s)          { return ((_stick | (s)) == (s)); };
+    void stick(Stick s)               { if (_stick != s) { _stick = s; _changed = true; } };
+    boolean isStick(Stick s)          { return ((_stick & (s)) == (s)); };
 
     boolean local(void)               { return _localControl;};
-    void local(boolean b)             { _localControl = b; };
+    void local(boolean b)             { if (_localControl != b) { _localControl = b; _changed = true; } };
 
     Aspects LeftAspect(void) {
 	                                  return (is(LEFT)                             ? CLEAR 
@@ -109,6 +134,13 @@ public:
     byte rightindication()            { return ((_reported == RIGHT) ? 0 : 1 ); } 	// and K#NG indications
 
     boolean named(char *n)            { return strcmp(n, _name) == 0; }
+    const char *name(void)            { return _name; }
+    byte id(void)                     { return _id; }		// index in sig[], for traces
+    void id(byte i)                   { _id = i; }
+    // heads whose aspect depends on this signal, and whether it changed since last asked
+    unsigned long dependents(void)    { return _dependents; }
+    void dependent(byte head)         { if (head < 32) bitSet(_dependents, head); }
+    boolean changed(void)             { boolean c = _changed; _changed = false; return c; }
     void print(void)                  { 
                                         for(int x = 7-strlen(_name); x > 0; x--) { Serial.print(" "); }
                                         Serial.print(_name); Serial.print(" rpt:"); Serial.print(toString(_reported));Serial.print(" cmd: "); Serial.print(toString(_commanded));
@@ -119,6 +151,11 @@ public:
 private:
 	void _init(const char *name, TrackCircuit *tk) { 
 										_name = name; 
+										_id = 0;
+										_dependents = 0;
+										_changed = true;
+										_ctlL = _ctlR = 0xFF;
+										_indL = _indR = 0xFF;
 										_stick = RRSignal::NONE;
 										_wascommanded = _reported = _commanded = RRSignal::UNKNOWN; 
 										_timer = RRSignal::NOTIMER; 
@@ -142,6 +179,13 @@ private:
         }
 	}
     const char *_name;
+    byte  _id;
+    unsigned long _dependents;
+    boolean _changed;
+    byte  _ctlL;			// control packet bits
+    byte  _ctlR;
+    byte  _indL;			// indication packet bits
+    byte  _indR;
     State _reported;   
     State _wascommanded;   
     State _commanded;       
@@ -154,7 +198,7 @@ private:
 	boolean _approach;
 	boolean _localControl;
 	
-	elapsedMillis _delaytime;
+	ElapsedTime _delaytime;
     unsigned int _time2end;
     boolean runningTime;
 
@@ -10,9 +10,10 @@
 #define RRSIGNALHEAD_H
 #include <Arduino.h>
 #include <avr/pgmspace.h>
-#include <elapsedMillis.h>
+#include "Clock.h"
 #include <ControlPoint.h>
 #include <SPCoast.h>
+#include "Trace.h"
 
 class RRSignalHead {
 public:	
@@ -40,7 +41,7 @@ public:
 	    *bit1 = 1;  // default to
 	    *bit2 = 0;  // restrictive STOP
 	    int blinking = 0;
-	    switch (_commanded) {                            // 00 = green, 11 = dark, 01 = yellow, 10 = red
+	    switch (shown()) {                               // 00 = green, 11 = dark, 01 = yellow, 10 = red
 	      case RRSignalHead::CLEAR:                *bit1 = 0; *bit2 = 0; blinking = 0; break;  //  G
 	      case RRSignalHead::LIMITED_CLEAR:        *bit1 = 0; *bit2 = 0; blinking = 1; break;  // (G)
 	      case RRSignalHead::ADVANCED_APPROACH:    *bit1 = 1; *bit2 = 0; blinking = 1; break;  // (Y)
@@ -54,6 +55,9 @@ public:
 	      blinker = 0;
 	      blinkstate = (blinkstate == 0 ? 1 : 0);
 	    }
+	    if (blinking) {
+	      blinker.deadline(901);
+	    }
 	    if (blinking && blinkstate) {
 	      *bit1 = *bit2 = 1;  // dark
 	    }
@@ -67,8 +71,9 @@ public:
     void pack(void) {
 		int bit1, bit2;
 		aspect2twobitindication(&bit1, &bit2);
+		_changed = false;
 		if (_setAspect) {
-			_setAspect(_name, _commanded, bit1, bit2);
+			_setAspect(_name, shown(), bit1, bit2);
 		} else if (_m) {
 			pack(_m, _bitpos1, _bitpos2, bit1, bit2);
 		}
@@ -89,17 +94,62 @@ public:
     Aspects is(void)             	  { return (_commanded); };
     boolean is(Aspects s)             { return (_commanded == s); };
 	boolean named(char *n)            { return strcmp(n, _name) == 0; };
-    void set(Aspects s)               { _commanded = s; };
+	const char *name(void)            { return _name; };
+    void set(Aspects s)               { if (_nextcp) s = approach(s, _nextaspect);
+	                                    if (_commanded != s) { TRACEEVENT(Trace::ASPECT, _id, _commanded, s); _changed = true; }
+	                                    _commanded = s; 
+									  };
+	// CLEAR becomes APPROACH or ADVANCED_APPROACH depending on what the next signal shows
+    static Aspects approach(Aspects mine, Aspects next) {
+		if (mine != CLEAR) return mine;
+		switch (next) {
+			case CLEAR:
+			case LIMITED_CLEAR:     return CLEAR;
+			case APPROACH:          return ADVANCED_APPROACH;
+			case ADVANCED_APPROACH: return CLEAR;
+			default:                return APPROACH;
+		}
+	};
+	// the next signal's head, usually in the next control point (see ControlPoint::advertise)
+	void follow(int cp, byte h)       { _nextcp = cp; _nexthead = h; _nextaspect = STOP; };
+	int  following(void)              { return _nextcp; };
+	boolean follows(int cp, byte h)   { return _nextcp && (_nextcp == cp) && (_nexthead == h); };
+	boolean nextAspect(Aspects a)     { if (_nextaspect == a) return false; _nextaspect = a; return true; };
+	Aspects nextAspect(void)          { return _nextaspect; };
+	/*
+	 * Approach lighting: the head stays DARK until a train is on one of its
+	 * approach tracks (bit per track[] index, first 32).  Only what is
+	 * shown changes - is() still gives the aspect, for the vital logic and
+	 * for advertise().  ControlPoint keeps lit() up to date.
+	 */
+	void approachLit(byte track)      { if (track < 32) bitSet(_approach, track); lit(false); };
+	unsigned long approachLit(void)   { return _approach; };
+	void lit(boolean b)               { if (_lit != b) { _lit = b; _changed = true; } };
+	boolean lit(void)                 { return _lit; };
+	Aspects shown(void)               { return _lit ? _commanded : DARK; };
+	// an exit head, whose aspect the heads behind it follow
+	void advertise(boolean b)         { _advertise = b; _told = 0xFF; };
+	boolean advertises(void)          { return _advertise; };
+	boolean told(void)                { return _told == _commanded; };
+	void tell(void)                   { _told = _commanded; };
+	void untell(void)                 { _told = 0xFF; };
+    byte id(void)                     { return _id; };		// index in head[], for traces
+    void id(byte i)                   { _id = i; };
+    RRSignal *signal(void)            { return _sig; };
+    I2Cextender *port(void)           { return _m; };
+    boolean flashing(void)            { Aspects a = shown(); return a == LIMITED_CLEAR || a == ADVANCED_APPROACH || a == RESTRICTING; };
+    // does the output need to be written again - new aspect, or time to flash?
+    boolean needsPack(void)           { return _changed || (flashing() && (blinker > 900)); };
 	//boolean hasSig()				  { return _sig ? true : false; }
 	//void setWithSig(void)			  { 
 	//									if (_sig) { set((*_sig).is(RRSignal::ALLSTOP) ? STOP: CLEAR); }
 	//								  }
     void print(void) {
 #ifdef DEBUG
-	    const char *s;
 	    for(int x = 7-strlen(_name); x > 0; x--) { Serial.print(" "); }
 	    Serial.print(_name); Serial.print(":"); 
 		Serial.print(toString(_commanded));
+		if (!_lit) Serial.print(" (dark)");
 #endif
     };
 
@@ -107,6 +157,8 @@ public:
 private:
 	void _init(const char *name, RRSignal *sig, void (*setFunction)(const char*, Aspects, int, int), I2Cextender *m, int bitpos1, int bitpos2) { 
 		_name = name;
+		_id = 0;
+		_changed = true;
 		_sig = sig;
 		_commanded = RRSignalHead::STOP;
 		_setAspect = setFunction;
@@ -115,6 +167,13 @@ private:
 		_bitpos2   = bitpos2;
 		blinkstate = 0;
 		_routes    = NULL;
+		_nextcp    = 0;
+		_nexthead  = 0;
+		_nextaspect = RRSignalHead::STOP;
+		_advertise = false;
+		_told      = 0xFF;
+		_approach  = 0;
+		_lit       = true;
 	};
 	
 	const char *toString(Aspects a) {
@@ -129,9 +188,11 @@ private:
         }
     }
 
-	elapsedMillis blinker;
+	ElapsedTime blinker;
 	boolean blinkstate;
     const char    *_name;
+	byte          _id;
+	boolean       _changed;
 	RRSignal      *_sig;
 	I2Cextender   *_m;
 	int           _bitpos1;
@@ -139,6 +200,13 @@ private:
 	Aspects       _commanded;  
 	void (*_setAspect)(const char*, Aspects, int, int); 
 	void*  _routes; 
+	int           _nextcp;		// codeline address of the next signal's control point, 0 = none
+	byte          _nexthead;
+	Aspects       _nextaspect;
+	boolean       _advertise;
+	byte          _told;		// aspect last advertised
+	unsigned long _approach;	// approach tracks, bit per track[] index
+	boolean       _lit;
 };
 
 
@@ -0,0 +1,92 @@
+/*
+ *    Route through an interlocking
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef ROUTE_H
+#define ROUTE_H
+#include <Arduino.h>
+#include "RRSignal.h"
+
+/*
+ * A route: the signal that governs it, the switch positions it needs, and
+ * the track circuits it covers.  Declared as a PROGMEM string of names,
+ * with "=" giving the signal's direction and each switch's position:
+ *
+ *      const char r2LW[] PROGMEM = "S2=L W1=N OS WA approach=EA";
+ *      Route route[] = { Route("2L-WA", r2LW), ... };
+ *
+ * An "approach" track is where a train waits for the signal; it isn't part
+ * of the route, but keeps it locked while the signal runs time.
+ *
+ * ControlPoint::begin() looks the names up once and keeps the result as
+ * bitmasks - switches (bit per sw[] index), which of those must be reverse,
+ * tracks (bit per track[] index), approach tracks, and the other routes
+ * (bit per route[] index) that can't be set at the same time.  Only the
+ * first 32 of each can take part.
+ */
+
+class Route {
+public:
+	Route(const char *name, const char *spec) { _init(name, spec); };
+
+	const char     *name(void)             { return _name; };
+	const char     *spec(void)             { return _spec; };		// PROGMEM
+	boolean         named(char *n)         { return strcmp(n, _name) == 0; };
+
+	byte            signal(void)           { return _signal; };		// index in sig[], 0xFF = none
+	RRSignal::State direction(void)        { return _direction; };
+	unsigned long   switches(void)         { return _switches; };
+	unsigned long   reverse(void)          { return _reverse; };		// which of switches() must be REVERSE
+	unsigned long   tracks(void)           { return _tracks; };
+	unsigned long   approach(void)         { return _approach; };
+	unsigned long   conflicts(void)        { return _conflicts; };
+	// the switches are where this route needs them
+	boolean         lined(unsigned long normal, unsigned long rev) {
+	                                         return (((normal & ~_reverse) | (rev & _reverse)) & _switches) == _switches; };
+	boolean         conflicts(Route *r)    { return (_tracks & r->_tracks) ||
+	                                                (_switches & r->_switches & (_reverse ^ r->_reverse)); };
+
+	// filled in by ControlPoint::begin()
+	void            clear(void)            { _signal = 0xFF; _direction = RRSignal::UNKNOWN;
+	                                         _switches = _reverse = _tracks = _approach = _conflicts = 0; };
+	void            signal(byte s, RRSignal::State d) { _signal = s; _direction = d; };
+	void            add(byte sw, boolean reverse)     { if (sw < 32) { bitSet(_switches, sw); bitWrite(_reverse, sw, reverse); } };
+	void            track(byte t)          { if (t < 32) bitSet(_tracks, t); };
+	void            approachTrack(byte t)  { if (t < 32) bitSet(_approach, t); };
+	void            conflict(byte r)       { if (r < 32) bitSet(_conflicts, r); };
+
+	void print(void)                      {
+	                                        for (int x = 7 - strlen(_name); x > 0; x--) { Serial.print(" "); }
+	                                        Serial.print(_name);
+	                                        Serial.print(" sig:");   Serial.print(_signal);
+	                                        Serial.print(_direction == RRSignal::LEFT ? "L" : _direction == RRSignal::RIGHT ? "R" : "?");
+	                                        Serial.print(" sw:");    Serial.print(_switches, HEX);
+	                                        Serial.print(" rev:");   Serial.print(_reverse, HEX);
+	                                        Serial.print(" trk:");   Serial.print(_tracks, HEX);
+	                                        Serial.print(" appr:");  Serial.print(_approach, HEX);
+	                                        Serial.print(" conf:");  Serial.print(_conflicts, HEX);
+	                                        Serial.print(" ");
+	                                      };
+private:
+	void _init(const char *name, const char *spec) {
+		_name = name;
+		_spec = spec;
+		clear();
+	};
+
+	const char     *_name;
+	const char     *_spec;
+	byte            _signal;
+	RRSignal::State _direction;
+	unsigned long   _switches;
+	unsigned long   _reverse;
+	unsigned long   _tracks;
+	unsigned long   _approach;
+	unsigned long   _conflicts;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Cooperative multi-rate scheduler
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include <ControlPoint.h>		// for DEBUG
+#include "Scheduler.h"
+
+byte Scheduler::add(void (*fn)(void), unsigned int period, unsigned int budget, byte flags) {
+	if (_ntasks == SCHED_TASKS) return 0xFF;
+	Task *t = &_task[_ntasks];
+	t->fn     = fn;
+	t->period = period;
+	t->budget = budget;
+	t->due    = Clock::millis();
+	t->flags  = flags;
+	t->runs   = 0;
+	t->missed = t->overruns = t->worst = t->late = 0;
+	return _ntasks++;
+}
+
+void Scheduler::clear(void) {
+	for (byte x = 0; x < _ntasks; x++) {
+		_task[x].runs   = 0;
+		_task[x].missed = _task[x].overruns = _task[x].worst = _task[x].late = 0;
+	}
+}
+
+void Scheduler::execute(Task *t) {
+	unsigned long start = micros();
+	t->fn();
+	unsigned long took = micros() - start;
+	t->runs++;
+	if (took > t->worst) t->worst = (took > 0xFFFF) ? 0xFFFF : took;
+	if (t->budget && (took > t->budget)) t->overruns++;
+}
+
+void Scheduler::run(void) {
+	boolean ran = false;
+	byte x;
+
+	for (x = 0; x < _ntasks; x++) {
+		Task *t = &_task[x];
+		if (t->period) {
+			unsigned long now  = Clock::millis();
+			unsigned long late = now - t->due;
+			if ((long)late < 0) continue;
+			if (late > t->late) t->late = (late > 0xFFFF) ? 0xFFFF : late;
+			if (late >= t->period) {			// slept through whole releases
+				unsigned long lost = late / t->period;
+				t->missed += lost;
+				t->due    += lost * t->period;
+			}
+			t->due += t->period;
+			execute(t);
+			ran = true;
+		} else if (t->flags & TRIGGERED) {
+			t->flags &= ~TRIGGERED;
+			execute(t);
+			ran = true;
+		}
+	}
+
+	if (!ran) {
+		for (byte n = 0; n < _ntasks; n++) {
+			x = (_nextbg + n) % _ntasks;
+			if (_task[x].flags & BACKGROUND) {
+				_nextbg = x + 1;
+				execute(&_task[x]);
+				break;
+			}
+		}
+	}
+
+	for (x = 0; x < _ntasks; x++) {
+		if (_task[x].period) Clock::deadline(_task[x].due);
+	}
+}
+
+#ifdef DEBUG
+void Scheduler::print(void) {
+	for (byte x = 0; x < _ntasks; x++) {
+		Task *t = &_task[x];
+		Serial.print("task ");     Serial.print(x);
+		Serial.print(" every ");   Serial.print(t->period);
+		Serial.print(" runs ");    Serial.print(t->runs);
+		Serial.print(" late ");    Serial.print(t->late);
+		Serial.print(" missed ");  Serial.print(t->missed);
+		Serial.print(" worst ");   Serial.print(t->worst);
+		Serial.print(" over ");    Serial.println(t->overruns);
+	}
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ *    Cooperative multi-rate scheduler
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <Arduino.h>
+#include "Clock.h"
+
+/*
+ * Runs each part of the sketch's loop() at its own rate, so a slow EEPROM write
+ * or a debug print can no longer hold up detector sampling.
+ *
+ *      Scheduler tasks;
+ *
+ *      void vital(void)    { ControlPoint::readall(); ...knockdowns...;
+ *                            ControlPoint::evaluateall(evaluate); ControlPoint::writeall(); }
+ *      void codeline(void) { if (ControlPoint::LnPacket2Controls(&src, &dst, controls) ...) {
+ *                                if (ControlPoint::applyControls(controls) == ControlPoint::ACCEPTED)
+ *                                    ControlPoint::savestateLater(controls);
+ *                            }
+ *                            if (ControlPoint::buildIndications(ind, changed)) ControlPoint::sendCodeLine(me, office, ind);
+ *                          }
+ *      void persist(void)  { ControlPoint::persiststate(); }
+ *
+ *      setup() { ...  tasks.every(5, vital, 2000);  tasks.every(20, codeline);  tasks.background(persist); }
+ *      loop()  { tasks.run(); }
+ *
+ * Tasks are run in the order they were added, so add the vital ones first.
+ * A periodic task is released every "ms" milliseconds on a fixed grid - running
+ * late does not push the later releases back.  If it is so late that a whole
+ * release went by, the lost releases are counted in missed() and skipped.
+ * A task that takes longer than its budget (in microseconds, 0 = no budget)
+ * is counted in overruns().  onDemand() tasks run on the next pass after
+ * trigger(); background() tasks take turns, one per pass, and only on a pass
+ * where nothing else was due.
+ *
+ * Nothing is pre-empted, so the worst input to output delay of the first task
+ * is its period plus the longest single run of any other task.  Keep
+ * background work in small steps, like persiststate(), which writes one
+ * EEPROM byte per call.
+ *
+ * run() reports the next release to Clock::deadline(), so simulations using
+ * virtual time can skip straight to it.
+ */
+
+#ifndef SCHED_TASKS
+#define SCHED_TASKS 8		// 24 bytes of RAM each
+#endif
+
+class Scheduler {
+public:
+	Scheduler(void)                                { _ntasks = 0; _nextbg = 0; };
+
+	byte every(unsigned int ms, void (*fn)(void), unsigned int budget = 0) { return add(fn, ms, budget, 0); };
+	byte onDemand(void (*fn)(void), unsigned int budget = 0)               { return add(fn, 0, budget, ONDEMAND); };
+	byte background(void (*fn)(void))                                      { return add(fn, 0, 0, BACKGROUND); };
+	void trigger(byte t)                           { if (t < _ntasks) _task[t].flags |= TRIGGERED; };
+	void run(void);
+
+	unsigned long runs(byte t)                     { return _task[t].runs; };
+	unsigned int  missed(byte t)                   { return _task[t].missed; };		// releases skipped
+	unsigned int  overruns(byte t)                 { return _task[t].overruns; };	// runs over budget
+	unsigned int  worst(byte t)                    { return _task[t].worst; };		// longest run, us
+	unsigned int  late(byte t)                     { return _task[t].late; };		// latest start, ms after release
+	void          clear(void);
+#ifdef DEBUG
+	void          print(void);
+#endif
+
+private:
+	enum Flags { ONDEMAND = 1, BACKGROUND = 2, TRIGGERED = 4 };
+	struct Task {
+		void          (*fn)(void);
+		unsigned int  period;
+		unsigned int  budget;
+		unsigned long due;
+		byte          flags;
+		unsigned long runs;
+		unsigned int  missed;
+		unsigned int  overruns;
+		unsigned int  worst;
+		unsigned int  late;
+	};
+	byte add(void (*fn)(void), unsigned int period, unsigned int budget, byte flags);
+	void execute(Task *t);
+
+	Task _task[SCHED_TASKS];
+	byte _ntasks;
+	byte _nextbg;		// background task whose turn it is
+};
+
+#endif
+
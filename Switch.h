@@ -9,9 +9,10 @@
 #ifndef SWITCH_H
 #define SWITCH_H
 #include <Arduino.h>
-#include <elapsedMillis.h>
+#include "Clock.h"
 #include "RRSignal.h"
 #include "TrackCircuit.h"
+#include "Trace.h"
 
 /*
  * A turnout on the layout
@@ -50,6 +51,11 @@ public:
 	};
 	
 	void unpack(State s) {
+		if (_failed) {			// stays ERROR until the points get where they were sent
+			if (s == target()) _failed = false;
+			else s = ERROR;
+		}
+		if (_real != s) { TRACEEVENT(Trace::SWITCH, _id, _real, s); _changed = true; }
 		_real = s; 
 	}
 	void unpack(I2Cextender *m, int bitposN, int bitposR) {
@@ -82,7 +88,7 @@ public:
 	}
 	void pack(void) {
 		if (_setState) {
-			_setState(_name, _real);
+			_setState(_name, hasFeedback() ? target() : _real);	// with feedback, drive it where it's going
 		} else if (_m) {
 			//Serial.print("Packing "); print(); Serial.println();
 			pack(_m, _bitposM, fieldcommand());
@@ -91,6 +97,7 @@ public:
 	
     State   is(void)                  { return _real;};       // actual layout state
     boolean is(State s)               { return (_real == s); };
+	// the signal that must be at STOP, and the track that must be EMPTY, before the points may move
 	void sig(RRSignal *s)             { _my_signal = s; }
 	void trk(TrackCircuit *tc)        { _my_track = tc; }
 	
@@ -107,16 +114,40 @@ public:
 	}
     boolean isSafe(int n, int r)      { return isSafe(toState(n,r)); }
 	boolean isSafe(State s) { 
-		if (s  == Switch::ERROR)   { return false; }
+		if (!check(s))             { return false; }
 		_safestate = s;
 		return true;
 	};
 	void  doSafe(void)				  { if (_safestate != UNKNOWN) { set(_safestate); _safestate = UNKNOWN; } }
+	void  abortSafe(void)             { _safestate = UNKNOWN; }		// another device refused, forget it
+	boolean check(State s)            { if (s == Switch::ERROR) return false;	// isSafe without remembering anything
+	                                    if ((s != NORMAL && s != REVERSE) || s == target() || s == _real) return true;	// not a move
+	                                    if (_my_track && !_my_track->is(TrackCircuit::EMPTY)) return false;	// detector locking
+	                                    if (_my_signal && !_my_signal->is(RRSignal::ALLSTOP)) return false;	// signal locking
+	                                    return true;
+	                                  }
+
+	// where this switch's N and R request bits are in a control packet, 0-63 (see ControlPoint::apply)
+	void  controls(int bitN, int bitR) { _ctlN = bitN; _ctlR = bitR; }
+	boolean hasControls(void)         { return _ctlN != 0xFF; }
+	byte  controlN(void)              { return _ctlN; }
+	byte  controlR(void)              { return _ctlR; }
+	State fromControls(int *controls) { return toState(CTLBIT(controls, _ctlN), CTLBIT(controls, _ctlR)); }
+	// and where its N and R indications go
+	void  indications(int bitN, int bitR) { _indN = bitN; _indR = bitR; }
+	void  indicate(int *ind)          { if (_indN != 0xFF) PUTBIT(ind, _indN, is(NORMAL));
+	                                    if (_indR != 0xFF) PUTBIT(ind, _indR, is(REVERSE)); }
 	
     boolean isC(State s)               { return (_commanded == s); };
     State commanded(void)             { return _commanded;};  // From the dispatcher/cTc machine
+    State target(void)                { return (_commanded == TIME) ? _nextcommanded : _commanded; };	// where it's going
 
-	void  set(State s)                { if ( (s == NORMAL) || (s == REVERSE)) { _nextcommanded = _commanded = s; } };
+	void  set(State s)                { if ( (s == NORMAL) || (s == REVERSE)) {
+											if (hasFeedback() && ((target() != s) || _failed)) { setSlowMotion(0, s); return; }
+											if (_commanded != s) { TRACEEVENT(Trace::SWITCHCMD, _id, _commanded, s); _changed = true; }
+											_nextcommanded = _commanded = s; 
+										}
+									  };
     void  set(int n, int r)           { set(toState(n,r)); };
 
 	// Use state from earlier isSafe call...
@@ -128,31 +159,84 @@ public:
                                         );
                                       }
 
-    byte fieldcommand(void)           { return ((_commanded == Switch::NORMAL) ? 0 : 1 ); }    // control bit - 0 = normal, 1 - reverse
+    byte fieldcommand(void)           { return ((target() == Switch::NORMAL) ? 0 : 1 ); }    // control bit - 0 = normal, 1 - reverse
+
+	/*
+	 * With feedback(timeout), a throw - set() or setSlowMotion() - finishes as soon as
+	 * the point detection reports the new position, instead of after a fixed time.
+	 * If it hasn't got there within timeout ms the switch goes to ERROR, and
+	 * stays there until the feedback matches what it was last sent.  Only for
+	 * switches that have feedback: a get callback, or N and R bits.
+	 */
+	void feedback(unsigned int timeout)   { _timeout = timeout; }
+	boolean hasFeedback(void)         { return _timeout && (_getState || (_m && (_bitposN != -1))); }
+#ifdef CP_STATS
+	// how long the throws took, in ms, for maintenance
+	unsigned int  throws(void)        { return _throws; }
+	unsigned int  throwMin(void)      { return _throws ? _throwmin : 0; }
+	unsigned int  throwMax(void)      { return _throwmax; }
+	unsigned int  throwAvg(void)      { return _throws ? _throwtotal / _throws : 0; }
+	byte          timeouts(void)      { return _timeouts; }
+	void          clearThrows(void)   { _throws = _throwmax = 0; _throwmin = 0xFFFF; _throwtotal = 0; _timeouts = 0; }
+#endif
 
     boolean isRunning(void)           { return (_timer != Switch::NOTIMER); }
     boolean isExpired(void)           { return (_timer == Switch::EXPIRED); }
     void setSlowMotion(int seconds, State s){
                                             // set a timer to simulate the time it takes a switch to throw...
+                                            // ...or, with feedback, to give up waiting for it
+                                            if (hasFeedback() && (_real == s)) {	// already there
+                                                if (_commanded != s) { TRACEEVENT(Trace::SWITCHCMD, _id, _commanded, s); _changed = true; }	// drive it back
+                                                _nextcommanded = _commanded = s;
+                                                _timer = Switch::NOTIMER;
+                                                return;
+                                            }
                                             _delaytime = 0;  
-                                            _time2end = (seconds *1000); 
+                                            _time2end = hasFeedback() ? _timeout : (seconds *1000); 
                                             _timer = Switch::RUNNING;
                                             _nextcommanded = s;
+                                            TRACEEVENT(Trace::SWITCHCMD, _id, _commanded, TIME);
+                                            _changed = true;
                                             _commanded = TIME; // register the change as happening, but don't let the plant change for xxx seconds...
 											// Serial.print("setSloMo: "); print(); Serial.println(); 
 
                                       }
     Timer runSlowMotion(void)               {
                                         if (isRunning()) {
-                                            if (_delaytime > _time2end) { // timer expired
+                                            if (hasFeedback() && (readLayout() == _nextcommanded)) {	// points are there
+#ifdef CP_STATS
+                                                unsigned long took = _delaytime;
+                                                if (took > 0xFFFF) took = 0xFFFF;
+                                                _throws++;
+                                                _throwtotal += took;
+                                                if (took < _throwmin) _throwmin = took;
+                                                if (took > _throwmax) _throwmax = took;
+#endif
                                                 _timer = Switch::EXPIRED;
+                                            } else if ((_delaytime > _time2end) && hasFeedback()) {	// stuck
+                                                TRACEEVENT(Trace::SWITCH, _id, _real, ERROR);
+#ifdef CP_STATS
+                                                if (_timeouts < 0xFF) _timeouts++;
+#endif
+                                                _failed = true;
+                                                _real = ERROR;
+                                                _commanded = _nextcommanded;
+                                                _timer = Switch::NOTIMER;
+                                                _changed = true;
+                                                return Switch::EXPIRED;
+                                            } else if (_delaytime > _time2end) { // timer expired
+                                                _timer = Switch::EXPIRED;
+                                            } else {
+                                                _delaytime.deadline(_time2end + 1);
                                             }
 											// Serial.print("runningSloMo: "); print(); Serial.println(); 
 
                                         } 
                                         if (_timer == Switch::EXPIRED) {
+                                          TRACEEVENT(Trace::SWITCH, _id, _real, _nextcommanded);
                                           _real = _commanded = _nextcommanded;
                                           _timer = Switch::NOTIMER;
+                                          _changed = true;
 										  //Serial.print("doneSloMo: "); print(); Serial.println(); 
 										  return Switch::EXPIRED;
                                         }  
@@ -160,6 +244,13 @@ public:
                                       }
                                       
     char * name(void)                 { return _name; }
+    byte id(void)                     { return _id; }		// index in sw[], for traces
+    void id(byte i)                   { _id = i; }
+	I2Cextender *port(void)           { return _m; }
+	// heads whose aspect depends on this switch, and whether anything moved since last asked
+	unsigned long dependents(void)    { return _dependents; }
+	void dependent(byte head)         { if (head < 32) bitSet(_dependents, head); }
+	boolean changed(void)             { boolean c = _changed; _changed = false; return c; }
 	boolean named(char *n)            { return strcmp(n, _name) == 0; }
     void print(void)                  { 
                                         for(int x = 7-strlen(_name); x > 0; x--) { Serial.print(" "); }
@@ -175,6 +266,15 @@ public:
 										Serial.print(toString(_safestate));
 										Serial.print(" field:"); 
 										Serial.print(fieldcommand(), BIN);
+#ifdef CP_STATS
+                                        if (_throws || _timeouts) {
+                                            Serial.print(" throw ms:"); Serial.print(throwMin());
+                                            Serial.print("/");          Serial.print(throwAvg());
+                                            Serial.print("/");          Serial.print(throwMax());
+                                            Serial.print(" x");         Serial.print(_throws);
+                                            Serial.print(" stuck:");    Serial.print(_timeouts);
+                                        }
+#endif
                                         Serial.print(" ");
                                       };
 private:
@@ -188,6 +288,18 @@ private:
 		_bitposM = bitposM;
 		_nextcommanded = _commanded = _real = _safestate = Switch::UNKNOWN; 
 		_timer = Switch::NOTIMER;; 
+		_id = 0;
+		_dependents = 0;
+		_changed = true;
+		_ctlN = _ctlR = 0xFF;
+		_indN = _indR = 0xFF;
+		_my_signal = NULL;
+		_my_track = NULL;
+		_timeout = 0;
+		_failed = false;
+#ifdef CP_STATS
+		clearThrows();
+#endif
 	};
     
 
@@ -201,6 +313,13 @@ private:
 		};
 	};
 	char *_name;
+	byte  _id;
+	unsigned long _dependents;
+	boolean _changed;
+	byte  _ctlN;			// control packet bits
+	byte  _ctlR;
+	byte  _indN;			// indication packet bits
+	byte  _indR;
     State _commanded;      // from cTc
     State _nextcommanded;  // delayed, from commanded
     State _safestate;      // delayed, from safe test
@@ -214,11 +333,21 @@ private:
 	int 		_bitposM;
 
     Timer _timer;
-	elapsedMillis _delaytime;
+	ElapsedTime _delaytime;
 	unsigned int _time2end;
     boolean runningTime;
     RRSignal *_my_signal;
     TrackCircuit *_my_track;
+
+	unsigned int  _timeout;		// ms, 0 = fixed time slow motion
+	boolean       _failed;		// timed out, stuck at ERROR
+#ifdef CP_STATS
+	unsigned int  _throws;
+	unsigned int  _throwmin;
+	unsigned int  _throwmax;
+	unsigned long _throwtotal;
+	byte          _timeouts;
+#endif
 };
 
 #endif
@@ -0,0 +1,67 @@
+/*
+ * Binary event trace ring
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include <ControlPoint.h>
+#include "Trace.h"
+
+#ifdef TRACE
+CP_THREADLOCAL Trace::Entry Trace::_ring[TRACE_SIZE];
+CP_THREADLOCAL byte         Trace::_head  = 0;
+CP_THREADLOCAL byte         Trace::_count = 0;
+CP_THREADLOCAL unsigned int Trace::_lost  = 0;
+
+void Trace::record(Event e, byte id, byte a, byte b) {
+	Entry *p = &_ring[_head];
+	p->event = e;
+	p->id    = id;
+	p->a     = a;
+	p->b     = b;
+	p->time  = (unsigned int)Clock::millis();
+	if (++_head == TRACE_SIZE) _head = 0;
+	if (_count == TRACE_SIZE) {
+		_lost++;		// overwrote the oldest one
+	} else {
+		_count++;
+	}
+}
+
+void Trace::write(Print &out, Entry *e) {
+	byte buf[6];
+	buf[0] = 0x80 | e->event;
+	buf[1] = e->id;
+	buf[2] = e->a;
+	buf[3] = e->b;
+	buf[4] = e->time & 0xFF;
+	buf[5] = (e->time >> 8) & 0xFF;
+	out.write(buf, sizeof(buf));
+}
+
+int Trace::drain(Print &out, int maxevents, boolean mayblock) {
+	int sent = 0;
+	// unless told otherwise, only write what fits in the serial transmit buffer, so we never wait on the UART
+	int room = mayblock ? 6 * maxevents : out.availableForWrite();
+	while (_count && (sent < maxevents) && (room >= 6)) {
+		int tail = _head - _count;
+		if (tail < 0) tail += TRACE_SIZE;
+		write(out, &_ring[tail]);
+		_count--;
+		sent++;
+		room -= 6;
+	}
+	return sent;
+}
+
+void Trace::dump(Print &out) {
+	while (_count) {
+		int tail = _head - _count;
+		if (tail < 0) tail += TRACE_SIZE;
+		write(out, &_ring[tail]);
+		_count--;
+	}
+}
+#endif
@@ -0,0 +1,96 @@
+/*
+ *    Binary event trace
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <Arduino.h>
+#include "Clock.h"
+
+/*
+ * A fixed size ring of typed, timestamped events
+ *
+ * Recording an event costs a handful of byte stores, so it can be left on
+ * in the vital path without changing the timing being debugged - unlike
+ * printEverything() and friends, which take many milliseconds at 57600 baud.
+ *
+ * Each event goes out on the wire as 6 bytes:
+ *
+ *      0     0x80 | event
+ *      1     device id (index into track[], sw[], sig[], head[]...)
+ *      2     a     (usually the old state)
+ *      3     b     (usually the new state)
+ *      4-5   Clock::millis(), low 16 bits, little endian
+ *
+ * Call Trace::drain(Serial, n) from loop() to trickle events out without
+ * blocking, or Trace::dump(Serial) to empty the ring on demand.
+ * tools/tracedump.cpp turns the result back into text.  drain() sends only
+ * what availableForWrite() says fits in the transmit buffer, so a full
+ * buffer - or a Print that doesn't implement availableForWrite() - gets
+ * nothing.  For a Print like that, Trace::drain(out, n, true) sends up to n
+ * events whether or not they fit, and may wait for them to go out.
+ *
+ * When the ring is full the oldest events are overwritten and counted in lost().
+ *
+ * Tracing is off unless TRACE is defined - uncomment it in ControlPoint.h or
+ * build with -DTRACE.  Off, TRACEEVENT() compiles to nothing, the ring takes
+ * no RAM, and the calls below do nothing.
+ */
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 32		// 6 bytes of RAM each
+#endif
+
+#ifdef TRACE
+#define TRACEEVENT(e, id, a, b)	Trace::record((e), (id), (a), (b))
+#else
+#define TRACEEVENT(e, id, a, b)
+#endif
+
+class Trace {
+public:
+	// MUST be the SAME as tools/tracedump.cpp's version
+	enum Event { NONE, TRACK, SWITCH, SWITCHCMD, SIGNAL, KNOCKDOWN, TIME, ASPECT, RX, TX, EEPROMWRITE, MARK, ROUTE, DROP, NOADDRESS, FULL };
+
+#ifdef TRACE
+	static void         record(Event e, byte id, byte a, byte b);
+	static int          drain(Print &out, int maxevents)      { return drain(out, maxevents, false); };	// never blocks
+	static int          drain(Print &out, int maxevents, boolean mayblock);	// returns # events written
+	static void         dump(Print &out);					// blocks until the ring is empty
+	static int          pending(void)          { return _count; };
+	static unsigned int lost(void)             { return _lost; };
+	static void         clear(void)            { _head = _count = 0; _lost = 0; };
+#else
+	static void         record(Event e, byte id, byte a, byte b) { };
+	static int          drain(Print &out, int maxevents)         { return 0; };
+	static int          drain(Print &out, int maxevents, boolean mayblock) { return 0; };
+	static void         dump(Print &out)                         { };
+	static int          pending(void)          { return 0; };
+	static unsigned int lost(void)             { return 0; };
+	static void         clear(void)            { };
+#endif
+
+private:
+	struct Entry {
+		byte         event;
+		byte         id;
+		byte         a;
+		byte         b;
+		unsigned int time;
+	};
+	static void  write(Print &out, Entry *e);
+
+#ifdef TRACE
+	static CP_THREADLOCAL Entry        _ring[TRACE_SIZE];
+	static CP_THREADLOCAL byte         _head;		// next slot to write
+	static CP_THREADLOCAL byte         _count;		// slots in use
+	static CP_THREADLOCAL unsigned int _lost;
+#endif
+};
+
+#endif
+
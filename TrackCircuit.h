@@ -10,6 +10,11 @@
 #define TRACKCIRCUIT_H
 #include <Arduino.h>
 #include <I2Cextender.h>
+#include "Trace.h"
+
+// bit b (0-63) of an 8 byte control or indication packet
+#define CTLBIT(packet, b)		(((packet)[(b) >> 3] >> ((b) & 7)) & 1)
+#define PUTBIT(packet, b, v)	bitWrite((packet)[(b) >> 3], (b) & 7, (v))
 
 class TrackCircuit {
 public:
@@ -24,10 +29,21 @@ public:
     boolean isOccupied()              { return (_real == TrackCircuit::OCCUPIED); };
     const char* name(void)            { return  _name; };
     boolean named(char *n)            { return strcmp(n, _name) == 0; }
+    byte id(void)                     { return _id; };		// index in track[], for traces
+    void id(byte i)                   { _id = i; };
+	// heads whose aspect depends on this track, and whether it changed since last asked
+    unsigned long dependents(void)    { return _dependents; };
+    void dependent(byte head)         { if (head < 32) bitSet(_dependents, head); };
+    boolean changed(void)             { boolean c = _changed; _changed = false; return c; };
+    // where the occupancy indication goes in the indication packet, 0-63
+    void indication(int bit)          { _ind = bit; };
+    void indicate(int *ind)           { if (_ind != 0xFF) PUTBIT(ind, _ind, isOccupied()); };
 
-	void unpack(State s)              { _real = s; }
+	void unpack(State s)              { if (_real != s) { TRACEEVENT(Trace::TRACK, _id, _real, s); _changed = true; }
+	                                    _real = s; 
+									  }
 	void unpack(I2Cextender *m, int bitpos) {
-		_real = bitRead((*(m)).current(), (bitpos))  ? TrackCircuit::EMPTY : TrackCircuit::OCCUPIED;
+		unpack(bitRead((*(m)).current(), (bitpos))  ? TrackCircuit::EMPTY : TrackCircuit::OCCUPIED);
 									  }
 	void unpack()					  {
 								        if (_setState) {
@@ -52,12 +68,20 @@ public:
 private:
 	void _init(const char *name, State (*setState)(const char *), I2Cextender *m, int bitpos) {
 		_name = name; 
+		_id = 0;
+		_dependents = 0;
+		_changed = true;
+		_ind = 0xFF;
 		_real = TrackCircuit::UNKNOWN;
 		_setState = setState;
 		_m = m;
 		_bitpos = bitpos;
 	}
     const char  *_name;
+	byte        _id;
+	unsigned long _dependents;
+	boolean     _changed;
+	byte        _ind;
 	I2Cextender *_m;
 	int         _bitpos;
 	State       (*_setState)(const char *);	
@@ -0,0 +1,87 @@
+/*
+ * Codeline transport throughput
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Pushes indication packets from one ControlPoint to another over each of the
+ * CodeLine transports and reports packets per second - i.e. what the codeline
+ * code itself costs once the 16.66 kbps LocoNet isn't the limit.
+ *
+ * Build (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make codelinebench                 (in tools/, makes build/codelinebench)
+ *
+ * Use:     codelinebench [packets] [batch]
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+
+// the library's default control point wants the sketch's tables; this program doesn't use it
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+static void bench(const char *name, CodeLine *from, CodeLine *to, long packets, int batch) {
+	ControlPoint a(10, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+	ControlPoint b(11, 1, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+	a.codeline(from);
+	b.codeline(to);
+
+	int  ind[8]      = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	int  controls[8];
+	int  src, dst;
+	long sent = 0, got = 0, bad = 0, stalls = 0;
+
+	auto t0 = std::chrono::steady_clock::now();
+	while (got < packets) {
+		for (int x = 0; x < batch && sent < packets; x++) {
+			ind[0] = sent & 0xFF;
+			ind[4] = (sent >> 8) & 0xFF;
+			if (a.send(11, ind) != LN_DONE) break;
+			sent++;
+		}
+		from->flush();
+		int n = 0;
+		while (b.receive(&src, &dst, controls)) {
+			if (src != 10 || controls[0] != (got & 0xFF) || controls[4] != ((got >> 8) & 0xFF)) bad++;
+			got++;
+			n++;
+		}
+		if (!n) stalls++;
+	}
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	printf("%-8s %8ld packets  %6.3f s  %10.0f packets/s  %8.2f us/packet  %ld bad  %ld empty polls\n",
+	       name, got, s, got / s, s * 1e6 / got, bad, stalls);
+}
+
+int main(int argc, char **argv) {
+	long packets = argc > 1 ? atol(argv[1]) : 200000;
+	int  batch   = argc > 2 ? atoi(argv[2]) : 32;
+	if (batch < 1) batch = 1;
+
+	QueueCodeLine q1, q2;
+	q1.connect(&q2);
+	bench("queue", &q1, &q2, packets, batch < CP_QUEUESIZE ? batch : CP_QUEUESIZE);
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/codelinebench.%d", (int)getpid());
+	UnixCodeLine server(path, true);
+	UnixCodeLine client(path, false);
+	bench("socket", &client, &server, packets, batch);
+
+	PtyCodeLine pty;
+	int fd = open(pty.name(), O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		perror(pty.name());
+		return 1;
+	}
+	FdCodeLine tty(fd);
+	bench("pty", &tty, &pty, packets, batch);
+	return 0;
+}
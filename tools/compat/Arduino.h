@@ -0,0 +1,126 @@
+/*
+ *    Host compatibility - the parts of the Arduino core the library uses
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Just enough of Arduino.h to build the library, the tools and the tests on
+ * a PC.  ARDUINO is deliberately left undefined, which is how the library
+ * tells it is on a host.  Serial goes to stdout; millis() and micros() are
+ * the host's monotonic clock.
+ */
+
+#ifndef ARDUINO_COMPAT_H
+#define ARDUINO_COMPAT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define HIGH	1
+#define LOW		0
+#define INPUT	0
+#define OUTPUT	1
+
+#define DEC		10
+#define HEX		16
+#define OCT		8
+#define BIN		2
+
+#define bitRead(value, bit)             (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)              ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)            ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue)  ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+// the binary constants the library uses
+#define B0			0
+#define B0001		1
+#define B0010		2
+#define B0100		4
+#define B1000		8
+#define B00000001	1
+#define B00000010	2
+#define B00000100	4
+#define B00001000	8
+#define B10000000	128
+
+unsigned long millis(void);
+unsigned long micros(void);
+inline void pinMode(int pin, int mode)         { };
+inline void digitalWrite(int pin, int value)   { };
+inline int  digitalRead(int pin)               { return LOW; };
+void        analogWrite(int pin, int value);	// remembered, see analogLevel()
+int         analogLevel(int pin);				// host only: the last analogWrite() to pin
+
+/*
+ * Print, as in the core: everything goes through write(), and the base
+ * class can't tell how much room there is (availableForWrite() is 0).
+ */
+class Print {
+public:
+	virtual ~Print(void)                                 { };
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buf, size_t n)   { size_t r = 0; while (n--) r += write(*buf++); return r; };
+	virtual int    availableForWrite(void)               { return 0; };
+
+	size_t write(const char *s)                          { return write((const uint8_t *)s, strlen(s)); };
+	size_t print(const char *s)                          { return write(s); };
+	size_t print(char c)                                 { return write((uint8_t)c); };
+	size_t print(unsigned char n, int base = DEC)        { return print((unsigned long)n, base); };
+	size_t print(int n, int base = DEC)                  { return print((long)n, base); };
+	size_t print(unsigned int n, int base = DEC)         { return print((unsigned long)n, base); };
+	size_t print(long n, int base = DEC) {
+		if (base == DEC) return number("%ld", n);
+		return print((unsigned long)n, base);
+	};
+	size_t print(unsigned long n, int base = DEC) {
+		if (base == HEX) return number("%lX", n);
+		if (base == OCT) return number("%lo", n);
+		if (base == BIN) {
+			char buf[33];
+			int  x = sizeof(buf) - 1;
+			buf[x] = 0;
+			do { buf[--x] = '0' + (n & 1); n >>= 1; } while (n);
+			return write(&buf[x]);
+		}
+		return number("%lu", n);
+	};
+	size_t print(double d, int digits = 2) {
+		char buf[40];
+		snprintf(buf, sizeof(buf), "%.*f", digits, d);
+		return write(buf);
+	};
+	size_t println(void)                                 { return write("\r\n"); };
+	template <class T> size_t println(T t)               { size_t r = print(t); return r + println(); };
+	template <class T> size_t println(T t, int base)     { size_t r = print(t, base); return r + println(); };
+private:
+	template <class T> size_t number(const char *fmt, T n) {
+		char buf[24];
+		snprintf(buf, sizeof(buf), fmt, n);
+		return write(buf);
+	};
+};
+
+class Stream : public Print {
+public:
+	virtual int available(void)                          { return 0; };
+	virtual int read(void)                               { return -1; };
+};
+
+class HardwareSerial : public Stream {
+public:
+	void   begin(long baud)                              { };
+	size_t write(uint8_t c)                              { return fputc(c, stdout) != EOF; };
+	size_t write(const uint8_t *buf, size_t n)           { return fwrite(buf, 1, n, stdout); };
+	int    availableForWrite(void)                       { return 63; };
+	using Print::write;
+};
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ *    Host compatibility - EEPROM as a RAM array
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Starts erased (0xFF), like a new part.  clear() erases it again, so a
+ * test or a replay can start from a known image.
+ */
+
+#ifndef EEPROM_COMPAT_H
+#define EEPROM_COMPAT_H
+#include <Arduino.h>
+
+#ifndef EEPROM_COMPAT_SIZE
+#define EEPROM_COMPAT_SIZE	8192
+#endif
+
+class EEPROMClass {
+public:
+	EEPROMClass(void)                          { clear(); };
+	uint8_t read(int a)                        { return (a >= 0 && a < EEPROM_COMPAT_SIZE) ? _mem[a] : 0xFF; };
+	void    write(int a, uint8_t v)            { if (a >= 0 && a < EEPROM_COMPAT_SIZE) { _mem[a] = v; _writes++; } };
+	void    update(int a, uint8_t v)           { if (read(a) != v) write(a, v); };
+	int     length(void)                       { return EEPROM_COMPAT_SIZE; };
+
+	// host only
+	void    clear(void)                        { memset(_mem, 0xFF, sizeof(_mem)); _writes = 0; };
+	long    writes(void)                       { return _writes; };
+private:
+	uint8_t _mem[EEPROM_COMPAT_SIZE];
+	long    _writes;
+};
+extern EEPROMClass EEPROM;
+
+#endif
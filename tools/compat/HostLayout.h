@@ -0,0 +1,73 @@
+/*
+ *    The sketch side tables the host tools and tests are built against
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * The library's default control point wants the m[], track[], sw[], sig[],
+ * head[] and mc[] tables and their getNum...() functions from the sketch.
+ * Include this in exactly one file of a program to get either
+ *
+ *      #define EMPTY_LAYOUT    empty tables, for programs that make their
+ *                              own control points and leave the default
+ *                              one alone, or
+ *
+ *      (nothing)               the interlocking the tools are built around:
+ *                              switch W1, signal S2 with heads 2L and 2R,
+ *                              track circuits WA, OS and EA and the four
+ *                              routes over them.  The program provides
+ *                              layoutTrack(name) and layoutPoints(name),
+ *                              the track circuits' and the switch's
+ *                              callbacks.
+ *
+ * The heads' route lists (what each aspect depends on besides its own
+ * signal) come with either, for programs with interlockings of their own.
+ */
+
+#ifndef HOSTLAYOUT_H
+#define HOSTLAYOUT_H
+#include <ControlPoint.h>
+
+const char routeL[] PROGMEM = "W1 WA OS";
+const char routeR[] PROGMEM = "W1 EA OS";
+const char * const routesL[] PROGMEM = { routeL, NULL };
+const char * const routesR[] PROGMEM = { routeR, NULL };
+
+#ifdef EMPTY_LAYOUT
+I2Cextender  m[1];
+TrackCircuit track[1] = { TrackCircuit("") };
+Switch       sw[1]    = { Switch((char *)"") };
+RRSignal     sig[1]   = { RRSignal("") };
+RRSignalHead head[1]  = { RRSignalHead("", &sig[0]) };
+Maintainer   mc[1]    = { Maintainer("", NULL) };
+int getNumPorts(void)         { return 0; }
+int getNumTrackCircuits(void) { return 0; }
+int getNumSwitches(void)      { return 0; }
+int getNumSignals(void)       { return 0; }
+int getNumHeads(void)         { return 0; }
+int getNumCalls(void)         { return 0; }
+#else
+TrackCircuit::State layoutTrack(const char *name);
+Switch::State       layoutPoints(const char *name);
+
+const char r2LN[] PROGMEM = "S2=L W1=N OS WA approach=EA";
+const char r2LR[] PROGMEM = "S2=L W1=R OS WA approach=EA";
+const char r2RN[] PROGMEM = "S2=R W1=N OS EA approach=WA";
+const char r2RR[] PROGMEM = "S2=R W1=R OS EA approach=WA";
+
+I2Cextender  m[1];
+TrackCircuit track[3] = { TrackCircuit("WA", layoutTrack), TrackCircuit("OS", layoutTrack), TrackCircuit("EA", layoutTrack) };
+Switch       sw[1]    = { Switch((char *)"W1", layoutPoints, NULL) };
+RRSignal     sig[1]   = { RRSignal("S2") };
+RRSignalHead head[2]  = { RRSignalHead("2L", &sig[0]), RRSignalHead("2R", &sig[0]) };
+Maintainer   mc[1]    = { Maintainer("", NULL) };
+Route        route[4] = { Route("2L-N", r2LN), Route("2L-R", r2LR), Route("2R-N", r2RN), Route("2R-R", r2RR) };
+int getNumPorts(void)         { return 0; }
+int getNumTrackCircuits(void) { return 3; }
+int getNumSwitches(void)      { return 1; }
+int getNumSignals(void)       { return 1; }
+int getNumHeads(void)         { return 2; }
+int getNumCalls(void)         { return 0; }
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ *    Host compatibility - a simulated I2C port extender
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * The same next / get() / current() / changed() / put() interface the
+ * library uses.  There is no hardware behind it: set "input" to what the
+ * field shows, and read "output" for what the last put() wrote.
+ */
+
+#ifndef I2CEXTENDER_COMPAT_H
+#define I2CEXTENDER_COMPAT_H
+#include <Arduino.h>
+
+class I2Cextender {
+public:
+	I2Cextender(void)                          { next = output = input = 0; _cur = 0; _changed = false; puts = 0; };
+
+	void    get(void)                          { _changed = (input != _cur); _cur = input; };
+	int     current(void)                      { return _cur; };
+	boolean changed(void)                      { return _changed; };
+	void    put(void)                          { output = next; puts++; };
+
+	int     next;		// what put() will write
+	int     output;		// host only: what it wrote
+	int     input;		// host only: what get() will read
+	long    puts;		// host only: how many put()s
+private:
+	int     _cur;
+	boolean _changed;
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ *    Host compatibility - the LocoNet library's message types
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * The message layout and status codes of the Arduino LocoNet library.
+ * There is no bus: the LocoNet object never receives anything and accepts
+ * everything sent, so host programs give their control points a CodeLine
+ * of their own (see CodeLine.h).
+ */
+
+#ifndef LOCONET_COMPAT_H
+#define LOCONET_COMPAT_H
+#include <Arduino.h>
+
+#define OPC_PEER_XFER	0xE5
+
+typedef struct {
+	uint8_t command, mesg_size, src, dst_l, dst_h, pxct1, d1, d2, d3, d4, pxct2, d5, d6, d7, d8, chksum;
+} peerXferMsg;
+typedef struct {
+	uint8_t command, mesg_size;
+} szMsg;
+typedef union {
+	szMsg       sz;
+	peerXferMsg px;
+	uint8_t     data[16];
+} lnMsg;
+
+typedef enum {
+	LN_CD_BACKOFF = 0, LN_PRIO_BACKOFF, LN_NETWORK_BUSY, LN_DONE, LN_COLLISION, LN_UNKNOWN_ERROR, LN_RETRY_ERROR
+} LN_STATUS;
+
+uint8_t getLnMsgSize(volatile lnMsg *msg);
+
+class LocoNetClass {
+public:
+	void      init(int txpin)                  { };
+	lnMsg    *receive(void)                    { return NULL; };
+	LN_STATUS send(lnMsg *msg)                 { return LN_DONE; };
+};
+extern LocoNetClass LocoNet;
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ *    Host compatibility - SPCoast.h
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Nothing in it is needed off the board.
+ */
+
+#ifndef SPCOAST_COMPAT_H
+#define SPCOAST_COMPAT_H
+#include <Arduino.h>
+#endif
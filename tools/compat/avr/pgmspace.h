@@ -0,0 +1,25 @@
+/*
+ *    Host compatibility - PROGMEM is ordinary memory on a host
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#ifndef PGMSPACE_COMPAT_H
+#define PGMSPACE_COMPAT_H
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P						const char *
+#define pgm_read_byte(a)			(*(const uint8_t *)(a))
+#define pgm_read_word(a)			(*(const uint16_t *)(a))
+#define pgm_read_dword(a)			(*(const uint32_t *)(a))
+#define pgm_read_ptr(a)				(*(void * const *)(a))
+#define strcpy_P					strcpy
+#define strncpy_P					strncpy
+#define strlen_P					strlen
+#define strcmp_P					strcmp
+#define memcpy_P					memcpy
+
+#endif
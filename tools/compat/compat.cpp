@@ -0,0 +1,34 @@
+/*
+ * Host compatibility - the objects and functions behind the headers
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ */
+
+#include <Arduino.h>
+#include <LocoNet.h>
+#include <EEPROM.h>
+#include <time.h>
+
+HardwareSerial Serial;
+EEPROMClass    EEPROM;
+LocoNetClass   LocoNet;
+
+static unsigned long long now_us(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec * 1000000ULL + t.tv_nsec / 1000;
+}
+static unsigned long long start_us = now_us();
+
+// both wrap at 32 bits, as on the board
+unsigned long millis(void) { return (uint32_t)((now_us() - start_us) / 1000); }
+unsigned long micros(void) { return (uint32_t)(now_us() - start_us); }
+
+static int analogLevels[64];
+void analogWrite(int pin, int value) { if (pin >= 0 && pin < 64) analogLevels[pin] = value; }
+int  analogLevel(int pin)            { return (pin >= 0 && pin < 64) ? analogLevels[pin] : 0; }
+
+uint8_t getLnMsgSize(volatile lnMsg *msg) {
+	return ((msg->sz.command & 0x60) == 0x60) ? msg->sz.mesg_size : ((msg->sz.command & 0x60) >> 4) + 2;
+}
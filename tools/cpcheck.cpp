@@ -0,0 +1,617 @@
+/*
+ * Exhaustive state space check of a control point's vital logic
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Runs the real Switch, RRSignal, RRSignalHead and ControlPoint code, with
+ * the layout's vital() and evaluate() logic, against every combination of
+ * track occupancy, switch point feedback, dispatcher controls and timer
+ * expiry that can be reached from power up, and checks that no head ever
+ * shows a proceed aspect (anything less restrictive than RESTRICTING) when
+ *
+ *      - a track circuit named in its routes is not EMPTY,
+ *      - a switch named in its routes is moving or isn't where it was sent, or
+ *      - its signal has routes (Route.h), and none of them is locked and lined.
+ *
+ * The first state that breaks one of these is printed as a counterexample:
+ * the shortest sequence of events that gets there from power up.
+ *
+ * Build (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make cpcheck                 (in tools/, makes build/cpcheck)
+ *
+ *      make cpcheck LAYOUT=mylayout.h to check your own control point
+ *      instead of the built in one (see below)
+ *
+ * Use:     cpcheck [-j workers] [-m megabytes] [-d depth] [-R]
+ *              -j  worker processes (default: one per CPU)
+ *              -m  memory for the visited set and frontiers (default 2048)
+ *              -d  stop after this many events (default: no limit)
+ *              -R  RESTRICTING counts as a proceed aspect too
+ *
+ *          exit status 0 = safe, 1 = counterexample found, 2 = ran out of room or depth
+ *
+ * A LAYOUT file provides the same things tools/lncapture.cpp wants - the
+ * m[], track[], sw[], sig[], head[] and mc[] tables and their getNum...()
+ * functions, layout(), vital() and evaluate(int head) - except that the track
+ * circuit callbacks must return checkTrack(name) and the switches' get
+ * callbacks checkPoints(name), so the checker decides where the trains and
+ * the points are.  All of the control point's state has to be in those
+ * tables: the checker saves and restores them, nothing else.
+ *
+ * How:  a state is the bytes of the device tables, the control point and
+ * the trains and points around it.  Each event is applied to a copy,
+ * followed by as many scans (readall, vital, evaluateall) as it takes to
+ * settle, and the result is new if its 64 bit fingerprint hasn't been seen.
+ * Search is breadth first, a level at a time; the sketch's tables are
+ * globals, so the workers are processes, each with its own copy, sharing
+ * the visited set, the frontiers and the parent links in shared memory.
+ * Only fingerprints are kept (hash compaction), so a collision could hide a
+ * state - the odds are printed at the end.
+ *
+ * Timers don't run: the clock stands still, and "time expires" is an event
+ * like any other, so every order of expiry is tried.
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <vector>
+#include <chrono>
+
+TrackCircuit::State checkTrack(const char *name);
+Switch::State       checkPoints(const char *name);
+
+#ifdef LAYOUT
+#include LAYOUT
+#else
+/*
+ * Built in layout: the interlocking in compat/HostLayout.h - a switch, a
+ * signal with two heads, three track circuits - with its route table, signal
+ * locking on the switch, and a knockdown if the points lose correspondence.
+ */
+#include <HostLayout.h>
+
+TrackCircuit::State layoutTrack(const char *name)  { return checkTrack(name); }
+Switch::State       layoutPoints(const char *name) { return checkPoints(name); }
+
+static void layout(void) {
+	sw[0].controls(0, 1);
+	sig[0].controls(2, 3);
+	sw[0].sig(&sig[0]);
+	head[0].setRoutes((void *)routesL);
+	head[1].setRoutes((void *)routesR);
+	ControlPoint::routeTable(route, 4);
+	sig[0].set(RRSignal::ALLSTOP);		// come up at stop
+}
+
+static void vital(void) {
+	if (track[1].isOccupied() || !sw[0].is(sw[0].target())) {
+		sig[0].knockdown();
+	} else if (!sig[0].isRunningTime() && sig[0].reported() != sig[0].commanded()) {
+		sig[0].report();
+	}
+}
+
+static void evaluate(int h) {
+	RRSignalHead::Aspects a = (RRSignalHead::Aspects)(h == 0 ? sig[0].LeftAspect() : sig[0].RightAspect());
+	if (a == RRSignalHead::CLEAR && track[h == 0 ? 0 : 2].isOccupied()) a = RRSignalHead::RESTRICTING;
+	head[h].set(a);
+}
+#endif
+
+#define T0        1000000UL		// the clock stands still here
+#define EXPIRE    0x40000000UL	// long enough for any timer
+#define SETTLE    16			// scans to wait for things to stop changing
+#define MAXDEV    32			// tracks, switches, signals, heads the properties look at
+#define NONE      0xFFFFFFFFUL
+
+// MUST be the SAME as the enums in TrackCircuit.h, Switch.h, RRSignal.h and RRSignalHead.h
+static const char *switchStates[] = { "UNKNOWN", "NORMAL", "REVERSE", "TIME", "ERROR" };
+static const char *signalStates[] = { "UNKNOWN", "LEFT", "RIGHT", "ALLSTOP", "TIME", "ERROR" };
+static const char *aspects[]      = { "CLEAR", "LIMITED_CLEAR", "ADVANCED_APPROACH", "APPROACH", "RESTRICTING", "STOP", "DARK" };
+static const char *why[]          = { "", "proceed into an occupied track", "proceed over points not in position", "proceed without a locked route" };
+enum Why { SAFE, OCCUPIED, POINTS, UNLOCKED };
+
+#define NAME(table, x)	((unsigned)(x) < sizeof(table) / sizeof(table[0]) ? table[x] : "?")
+
+/*
+ * The world outside the control point
+ */
+static byte envTrack[MAXDEV];		// 1 = a train is there
+static byte envPoints[MAXDEV];		// Switch::State the point detection reports
+
+TrackCircuit::State checkTrack(const char *name) {
+	for (int x = 0; x < getNumTrackCircuits() && x < MAXDEV; x++) {
+		if (track[x].name() == name || !strcmp(track[x].name(), name)) return envTrack[x] ? TrackCircuit::OCCUPIED : TrackCircuit::EMPTY;
+	}
+	return TrackCircuit::ERROR;
+}
+Switch::State checkPoints(const char *name) {
+	for (int x = 0; x < getNumSwitches() && x < MAXDEV; x++) {
+		if (sw[x].name() == name || !strcmp(sw[x].name(), name)) return (Switch::State)envPoints[x];
+	}
+	return Switch::ERROR;
+}
+
+class NullCodeLine : public CodeLine {
+public:
+	lnMsg *receive(void)                  { return NULL; }
+	int    send(lnMsg *msg)               { return LN_DONE; }
+};
+static NullCodeLine nowhere;
+
+/*
+ * Saving and restoring a state
+ */
+struct Region { void *p; size_t n; };
+static std::vector<Region> regions;
+static size_t              statesize;
+
+static void region(void *p, size_t n) { if (n) { Region r = { p, n }; regions.push_back(r); statesize += n; } }
+static void save(byte *to)            { for (size_t x = 0; x < regions.size(); x++) { memcpy(to, regions[x].p, regions[x].n); to += regions[x].n; } }
+static void load(const byte *from)    { for (size_t x = 0; x < regions.size(); x++) { memcpy(regions[x].p, from, regions[x].n); from += regions[x].n; } }
+
+#define MIX(h, v)	((h) = (((h) ^ (v)) * 0xFF51AFD7ED558CCDULL), (h) ^= (h) >> 31)
+
+static uint64_t fingerprint(const byte *p, size_t n) {
+	uint64_t l[4] = { 0x9E3779B97F4A7C15ULL ^ n, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x27D4EB2F165667C5ULL };
+	size_t x = 0;
+	for (; x + 32 <= n; x += 32) {		// four independent lanes keep the multiplier busy
+		uint64_t v[4];
+		memcpy(v, p + x, 32);
+		MIX(l[0], v[0]); MIX(l[1], v[1]); MIX(l[2], v[2]); MIX(l[3], v[3]);
+	}
+	uint64_t h = l[0];
+	MIX(h, l[1]); MIX(h, l[2]); MIX(h, l[3]);
+	for (; x < n; x++) h = (h ^ p[x]) * 0x100000001B3ULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h ? h : 1;		// 0 marks an empty slot
+}
+
+/*
+ * Events
+ */
+enum Kind { TRAIN, NOTRAIN, POINTS_ARRIVE, POINTS_LOST, CODE_N, CODE_R, CODE_L, CODE_RIGHT, CODE_STOP, SIGNAL_TIME, SWITCH_TIME };
+struct Event { byte kind; byte dev; };
+static std::vector<Event> events;
+
+static byte *scratch1, *scratch2;
+static byte *settled;				// what scan() ended with
+
+static void scan(void) {
+	byte *before = scratch1, *after = scratch2;
+	save(before);
+	settled = before;
+	for (int n = 0; n < SETTLE; n++) {
+		ControlPoint::readall();
+		vital();
+		ControlPoint::evaluateall(evaluate);
+		save(after);
+		settled = after;
+		if (!memcmp(before, after, statesize)) break;
+		byte *t = before; before = after; after = t;
+	}
+}
+
+static byte code(int bit1, int bit2) {
+	int controls[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	PUTBIT(controls, bit1, 1);
+	if (bit2 >= 0) PUTBIT(controls, bit2, 1);
+	return ControlPoint::applyControls(controls);
+}
+
+// apply an event, false if it can't happen here; result is what apply() said, for codes
+static boolean happen(Event e, byte *result) {
+	Switch   *w = &sw[e.dev];
+	RRSignal *s = &sig[e.dev];
+	*result = 0;
+	switch (e.kind) {
+	case TRAIN:         if (envTrack[e.dev]) return false;
+	                    envTrack[e.dev] = 1; break;
+	case NOTRAIN:       if (!envTrack[e.dev]) return false;
+	                    envTrack[e.dev] = 0; break;
+	case POINTS_ARRIVE: if ((w->target() != Switch::NORMAL && w->target() != Switch::REVERSE) || envPoints[e.dev] == w->target()) return false;
+	                    envPoints[e.dev] = w->target(); break;
+	case POINTS_LOST:   if (envPoints[e.dev] == Switch::UNKNOWN) return false;
+	                    envPoints[e.dev] = Switch::UNKNOWN; break;
+	case CODE_N:        if (w->target() == Switch::NORMAL) return false;
+	                    *result = code(w->controlN(), -1); break;
+	case CODE_R:        if (w->target() == Switch::REVERSE) return false;
+	                    *result = code(w->controlR(), -1); break;
+	case CODE_L:        if (s->target() == RRSignal::LEFT) return false;
+	                    *result = code(s->controlL(), -1); break;
+	case CODE_RIGHT:    if (s->target() == RRSignal::RIGHT) return false;
+	                    *result = code(s->controlR(), -1); break;
+	case CODE_STOP:     if (s->target() == RRSignal::ALLSTOP) return false;
+	                    *result = code(s->controlL(), s->controlR()); break;
+	case SIGNAL_TIME:   if (!s->isRunningTime()) return false;
+	                    Clock::advance(EXPIRE); s->runTime(); Clock::virtualTime(T0); break;
+	case SWITCH_TIME:   if (!w->isRunning()) return false;
+	                    Clock::advance(EXPIRE); w->runSlowMotion(); Clock::virtualTime(T0); break;
+	}
+	scan();
+	return true;
+}
+
+static void describe(Event e, byte result) {
+	switch (e.kind) {
+	case TRAIN:         printf("train onto %s", track[e.dev].name()); break;
+	case NOTRAIN:       printf("train leaves %s", track[e.dev].name()); break;
+	case POINTS_ARRIVE: printf("%s points report %s", sw[e.dev].name(), NAME(switchStates, envPoints[e.dev])); break;
+	case POINTS_LOST:   printf("%s points lose correspondence", sw[e.dev].name()); break;
+	case CODE_N:        printf("code %s NORMAL", sw[e.dev].name()); break;
+	case CODE_R:        printf("code %s REVERSE", sw[e.dev].name()); break;
+	case CODE_L:        printf("code %s LEFT", sig[e.dev].name()); break;
+	case CODE_RIGHT:    printf("code %s RIGHT", sig[e.dev].name()); break;
+	case CODE_STOP:     printf("code %s STOP", sig[e.dev].name()); break;
+	case SIGNAL_TIME:   printf("%s running time expires", sig[e.dev].name()); break;
+	case SWITCH_TIME:   printf("%s motion times out", sw[e.dev].name()); break;
+	}
+	if (result) printf(" (refused %d)", result);
+	printf("\n");
+}
+
+static void show(void) {
+	int x;
+	printf("        ");
+	for (x = 0; x < getNumHeads(); x++)    printf(" %s=%s", head[x].name(), NAME(aspects, head[x].is()));
+	printf("  |");
+	for (x = 0; x < getNumSwitches(); x++) {
+		printf(" %s=%s", sw[x].name(), NAME(switchStates, sw[x].is()));
+		if (sw[x].target() != sw[x].is()) printf("->%s", NAME(switchStates, sw[x].target()));
+	}
+	printf("  |");
+	for (x = 0; x < getNumSignals(); x++) {
+		printf(" %s=%s", sig[x].name(), NAME(signalStates, sig[x].reported()));
+		if (sig[x].commanded() != sig[x].reported()) printf("(%s)", NAME(signalStates, sig[x].commanded()));
+		if (sig[x].isRunningTime()) printf("(time)");
+	}
+	printf("  | occupied:");
+	for (x = 0; x < getNumTrackCircuits(); x++) if (!track[x].is(TrackCircuit::EMPTY)) printf(" %s", track[x].name());
+	printf("\n");
+}
+
+/*
+ * The safety properties
+ */
+static unsigned long headTracks[MAXDEV];
+static unsigned long headSwitches[MAXDEV];
+static byte          headSignal[MAXDEV];		// index in sig[], 0xFF = none
+static unsigned long routedSignals;
+static int           proceed = RRSignalHead::RESTRICTING;	// aspects below this are proceed
+
+static void properties(void) {
+	for (int h = 0; h < getNumHeads() && h < MAXDEV; h++) {
+		headSignal[h] = 0xFF;
+		for (int s = 0; s < getNumSignals() && s < MAXDEV; s++) {
+			if (head[h].signal() == &sig[s]) headSignal[h] = s;
+		}
+		const char* const* routes = head[h].getRoutes();
+		for (int r = 0; routes; r++) {
+			const char *p = (const char *)pgm_read_ptr(&routes[r]);
+			if (!p) break;
+			char token[16];
+			byte n = 0;
+			for (; ; p++) {
+				char c = pgm_read_byte(p);
+				if (isalnum(c) || c == '_') {
+					if (n < sizeof(token) - 1) token[n++] = c;
+					continue;
+				}
+				if (n) {
+					token[n] = '\0';
+					n = 0;
+					for (int x = 0; x < getNumTrackCircuits() && x < MAXDEV; x++) if (track[x].named(token)) bitSet(headTracks[h], x);
+					for (int x = 0; x < getNumSwitches() && x < MAXDEV; x++)      if (sw[x].named(token))    bitSet(headSwitches[h], x);
+				}
+				if (!c) break;
+			}
+		}
+	}
+	Route *r;
+	for (int x = 0; (r = ControlPoint::defaultCP().route(x)); x++) {
+		if (r->signal() < MAXDEV) bitSet(routedSignals, r->signal());
+	}
+}
+
+static Why violated(int *which) {
+	ControlPoint &cp = ControlPoint::defaultCP();
+	unsigned long occupied = 0, normal = 0, reverse = 0;
+	int x;
+	for (x = 0; x < getNumTrackCircuits() && x < MAXDEV; x++) if (!track[x].is(TrackCircuit::EMPTY)) bitSet(occupied, x);
+	for (x = 0; x < getNumSwitches() && x < MAXDEV; x++) {
+		if (sw[x].is(Switch::NORMAL))  bitSet(normal, x);
+		if (sw[x].is(Switch::REVERSE)) bitSet(reverse, x);
+	}
+	for (int h = 0; h < getNumHeads() && h < MAXDEV; h++) {
+		if (head[h].is() >= proceed) continue;
+		*which = h;
+		if (headTracks[h] & occupied) return OCCUPIED;
+		for (x = 0; x < getNumSwitches() && x < MAXDEV; x++) {
+			if (!bitRead(headSwitches[h], x)) continue;
+			if (sw[x].isRunning() || !sw[x].is(sw[x].target()) || !(bitRead(normal, x) || bitRead(reverse, x))) return POINTS;
+		}
+		byte s = headSignal[h];
+		if (s < MAXDEV && bitRead(routedSignals, s)) {
+			Route *r;
+			boolean ok = false;
+			for (x = 0; (r = cp.route(x)) && !ok; x++) {
+				ok = (r->signal() == s) && bitRead(cp.locked(), x) && r->lined(normal, reverse);
+			}
+			if (!ok) return UNLOCKED;
+		}
+	}
+	return SAFE;
+}
+
+/*
+ * Shared between the workers
+ */
+struct Link { uint32_t parent; uint16_t event; };
+struct Shared {
+	uint64_t next;			// frontier entries taken
+	uint64_t produced;		// entries in the next frontier
+	uint64_t states;		// links handed out
+	uint64_t transitions;
+	uint32_t bad;			// link of the first unsafe state, NONE
+	uint32_t badhead;
+	uint32_t badwhy;
+	uint32_t full;			// ran out of room
+};
+static Shared   *shared;
+static uint64_t *visited;
+static uint64_t  slots;
+static Link     *links;
+static uint64_t  maxstates;
+static byte     *frontier[2];
+static uint64_t  capacity;			// entries per frontier
+static size_t    entrysize;
+
+static boolean seen(uint64_t fp) {
+	uint64_t x = fp & (slots - 1);
+	for (uint64_t n = 0; n < slots; n++, x = (x + 1) & (slots - 1)) {
+		uint64_t v = __atomic_load_n(&visited[x], __ATOMIC_RELAXED);
+		if (v == fp) return true;
+		if (v == 0) {
+			uint64_t expect = 0;
+			if (__atomic_compare_exchange_n(&visited[x], &expect, fp, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return false;
+			if (expect == fp) return true;
+		}
+	}
+	__atomic_store_n(&shared->full, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+static void expand(byte *from, byte *to, uint64_t count) {
+	uint64_t transitions = 0;
+	for (;;) {
+		uint64_t first = __atomic_fetch_add(&shared->next, 16, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&shared->transitions, transitions, __ATOMIC_RELAXED);
+		transitions = 0;
+		if (first >= count || shared->full || shared->bad != NONE) return;
+		uint64_t last = (first + 16 < count) ? first + 16 : count;
+		for (uint64_t i = first; i < last; i++) {
+			byte    *entry  = from + i * entrysize;
+			uint32_t parent;
+			memcpy(&parent, entry, sizeof(parent));
+			for (size_t e = 0; e < events.size(); e++) {
+				byte result;
+				load(entry + 8);
+				if (!happen(events[e], &result)) continue;
+				transitions++;
+				if (seen(fingerprint(settled, statesize))) continue;
+				uint64_t id = __atomic_fetch_add(&shared->states, 1, __ATOMIC_RELAXED);
+				if (id >= maxstates) { __atomic_store_n(&shared->full, 1, __ATOMIC_RELAXED); return; }
+				links[id].parent = parent;
+				links[id].event  = e;
+				int h;
+				Why w = violated(&h);
+				if (w != SAFE) {
+					uint32_t expect = NONE;
+					if (__atomic_compare_exchange_n(&shared->bad, &expect, (uint32_t)id, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+						shared->badhead = h;
+						shared->badwhy  = w;
+					}
+					return;
+				}
+				uint64_t k = __atomic_fetch_add(&shared->produced, 1, __ATOMIC_RELAXED);
+				if (k >= capacity) { __atomic_store_n(&shared->full, 1, __ATOMIC_RELAXED); return; }
+				uint32_t self = id;
+				memcpy(to + k * entrysize, &self, sizeof(self));
+				memcpy(to + k * entrysize + 8, settled, statesize);
+			}
+		}
+	}
+}
+
+static void counterexample(byte *initial, uint32_t id) {
+	std::vector<uint16_t> path;
+	for (uint32_t x = id; x != 0; x = links[x].parent) path.push_back(links[x].event);
+	load(initial);
+	printf("\ncounterexample, %d events from power up:\n", (int)path.size());
+	printf("   0  power up\n");
+	show();
+	for (int n = (int)path.size() - 1, step = 1; n >= 0; n--, step++) {
+		byte result;
+		happen(events[path[n]], &result);
+		printf("%4d  ", step);
+		describe(events[path[n]], result);
+		show();
+	}
+	printf("\n%s %s\n", head[shared->badhead].name(), why[shared->badwhy]);
+}
+
+static void *share(size_t bytes) {
+	void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(2);
+	}
+	return p;
+}
+
+int main(int argc, char **argv) {
+	int    jobs     = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t mb       = 2048;
+	int    maxdepth = 0;
+	int    c;
+	while ((c = getopt(argc, argv, "j:m:d:R")) != -1) {
+		switch (c) {
+		case 'j': jobs     = atoi(optarg); break;
+		case 'm': mb       = atol(optarg); break;
+		case 'd': maxdepth = atoi(optarg); break;
+		case 'R': proceed  = RRSignalHead::STOP; break;
+		default:
+			fprintf(stderr, "use: %s [-j workers] [-m megabytes] [-d depth] [-R]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (jobs < 1) jobs = 1;
+	if (getNumTrackCircuits() > MAXDEV || getNumSwitches() > MAXDEV || getNumSignals() > MAXDEV || getNumHeads() > MAXDEV) {
+		fprintf(stderr, "only the first %d tracks, switches, signals and heads are checked\n", MAXDEV);
+	}
+
+	// power up
+	Clock::virtualTime(T0);
+	ControlPoint &cp = ControlPoint::defaultCP();
+	cp.codeline(&nowhere);
+	for (int x = 0; x < getNumSwitches() && x < MAXDEV; x++) envPoints[x] = Switch::NORMAL;
+	layout();
+	ControlPoint::setup();
+	properties();
+
+	region(m,     getNumPorts()         * sizeof(I2Cextender));
+	region(track, getNumTrackCircuits() * sizeof(TrackCircuit));
+	region(sw,    getNumSwitches()      * sizeof(Switch));
+	region(sig,   getNumSignals()       * sizeof(RRSignal));
+	region(head,  getNumHeads()         * sizeof(RRSignalHead));
+	region(mc,    getNumCalls()         * sizeof(Maintainer));
+	region(&cp,   sizeof(ControlPoint));
+	region(envTrack,  sizeof(envTrack));
+	region(envPoints, sizeof(envPoints));
+	scratch1 = (byte *)malloc(statesize);
+	scratch2 = (byte *)malloc(statesize);
+	scan();
+
+	for (byte x = 0; x < getNumTrackCircuits() && x < MAXDEV; x++) {
+		Event e = { TRAIN, x };   events.push_back(e);
+		e.kind = NOTRAIN;         events.push_back(e);
+	}
+	for (byte x = 0; x < getNumSwitches() && x < MAXDEV; x++) {
+		Event e = { POINTS_ARRIVE, x };  events.push_back(e);
+		e.kind = POINTS_LOST;            events.push_back(e);
+		e.kind = SWITCH_TIME;            events.push_back(e);
+		if (sw[x].hasControls()) {
+			e.kind = CODE_N;             events.push_back(e);
+			e.kind = CODE_R;             events.push_back(e);
+		}
+	}
+	for (byte x = 0; x < getNumSignals() && x < MAXDEV; x++) {
+		Event e = { SIGNAL_TIME, x };    events.push_back(e);
+		if (sig[x].hasControls()) {
+			e.kind = CODE_L;             events.push_back(e);
+			e.kind = CODE_RIGHT;         events.push_back(e);
+			e.kind = CODE_STOP;          events.push_back(e);
+		}
+	}
+
+	// a quarter of the memory for fingerprints, an eighth for parent links, the rest for two frontiers
+	size_t bytes = mb << 20;
+	for (slots = 1; slots * 2 * sizeof(uint64_t) <= bytes / 4; slots *= 2) ;
+	maxstates = slots / 2;
+	if (maxstates > NONE - 1) maxstates = NONE - 1;
+	entrysize = (8 + statesize + 7) & ~(size_t)7;
+	capacity  = (bytes - bytes / 4 - bytes / 8) / 2 / entrysize;
+	shared      = (Shared *)share(sizeof(Shared));
+	visited     = (uint64_t *)share(slots * sizeof(uint64_t));
+	links       = (Link *)share(maxstates * sizeof(Link));
+	frontier[0] = (byte *)share(capacity * entrysize);
+	frontier[1] = (byte *)share(capacity * entrysize);
+	shared->bad = NONE;
+
+	printf("%d tracks, %d switches, %d signals, %d heads: %d events, %d byte states, %d workers\n",
+	       getNumTrackCircuits(), getNumSwitches(), getNumSignals(), getNumHeads(),
+	       (int)events.size(), (int)statesize, jobs);
+
+	byte *initial = (byte *)malloc(statesize);
+	save(initial);
+	seen(fingerprint(initial, statesize));
+	shared->states = 1;				// link 0 is power up
+	int h;
+	if (violated(&h) != SAFE) {
+		shared->bad = 0;
+		shared->badhead = h;
+		shared->badwhy = violated(&h);
+	}
+	uint32_t zero = 0;
+	memcpy(frontier[0], &zero, sizeof(zero));
+	memcpy(frontier[0] + 8, initial, statesize);
+	uint64_t count = 1;
+	int      depth = 0;
+
+	auto t0 = std::chrono::steady_clock::now();
+	while (count && shared->bad == NONE && !shared->full && (!maxdepth || depth < maxdepth)) {
+		byte *from = frontier[depth & 1];
+		byte *to   = frontier[(depth + 1) & 1];
+		shared->next = shared->produced = 0;
+		int workers = (count / 64 + 1 < (uint64_t)jobs) ? count / 64 + 1 : jobs;
+		fflush(stdout);
+		if (workers == 1) {			// no need to fork for one
+			expand(from, to, count);
+			workers = 0;
+		}
+		for (int w = 0; w < workers; w++) {
+			pid_t pid = fork();
+			if (pid == 0) {
+				expand(from, to, count);
+				_exit(0);
+			} else if (pid < 0) {
+				perror("fork");
+				return 2;
+			}
+		}
+		int status, failed = 0;
+		while (wait(&status) > 0) failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+		if (failed) {
+			fprintf(stderr, "a worker died at depth %d\n", depth + 1);
+			return 2;
+		}
+		count = (shared->produced < capacity) ? shared->produced : capacity;
+		depth++;
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		printf("depth %3d  frontier %10llu  states %11llu  transitions %12llu  %6.1f s  %9.0f states/s\n",
+		       depth, (unsigned long long)count, (unsigned long long)shared->states,
+		       (unsigned long long)shared->transitions, s, shared->states / (s > 0 ? s : 1));
+	}
+
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	double n = (double)shared->states;
+	printf("\n%llu states, %llu transitions, depth %d, %.1f s\n",
+	       (unsigned long long)shared->states, (unsigned long long)shared->transitions, depth, s);
+	printf("chance a fingerprint collision hid a state: %.1e\n", n * n / 3.6893488147419103e19);
+
+	if (shared->bad != NONE) {
+		counterexample(initial, shared->bad);
+		return 1;
+	}
+	if (shared->full) {
+		printf("out of room after %llu states - give it more memory with -m\n", (unsigned long long)shared->states);
+		return 2;
+	}
+	if (count) {
+		printf("stopped at depth %d with %llu states still to look at\n", depth, (unsigned long long)count);
+		return 2;
+	}
+	printf("no reachable state shows a proceed aspect unsafely\n");
+	return 0;
+}
@@ -0,0 +1,450 @@
+/*
+ * cTc office server - the dispatcher's end of the codeline
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Collects the indication packets every control point sends with
+ * sendCodeLine() or publish()es into one packed state table, and tells whoever is
+ * interested (panels, CAD displays, loggers, scripts) what changed.
+ * Subscribers can send control packets back the other way.
+ *
+ * Build (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make ctcoffice                 (in tools/, makes build/ctcoffice)
+ *
+ * Use:     ctcoffice [-a address] [-s subscriber socket] [-p] [-l field socket]...
+ *                  serve: -p opens a pty for a LocoNet serial bridge, each -l
+ *                  listens on a UNIX socket for a field codeline; every line is
+ *                  its own codeline, with control points 0-127 on each
+ *          ctcoffice -g capture #CPs #packets
+ *                  generate a synthetic capture (a raw LocoNet byte stream)
+ *          ctcoffice -r capture... [-n subscribers]
+ *                  replay benchmark: one line per capture file
+ *
+ * Control points are numbered line * 128 + codeline address.
+ *
+ * Subscriber protocol - text lines, so a shell script can take part:
+ *
+ *  office -> subscriber
+ *      I <cp> <8 indication bytes, hex> <changed byte mask, hex>
+ *              the first I for a control point has every byte marked changed
+ *  subscriber -> office
+ *      C <cp> <8 control bytes, hex>     send a control packet
+ *      S                                 send me an I line for everything known
+ *
+ * Work is done in batches: every frame that is waiting on every line is
+ * applied to the table first, noting which control points changed, and then
+ * one I line per changed control point goes out - so a control point that
+ * sent three packets since the last batch costs one event, not three.
+ * A subscriber that falls more than CTC_SUBBUFFER bytes behind is dropped.
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#define CTC_MAXLINES    16
+#define CTC_PERLINE     128				// 7 bit codeline source address
+#define CTC_MAXCPS      (CTC_MAXLINES * CTC_PERLINE)
+#define CTC_BATCH       256				// max frames per line per batch
+#define CTC_SUBBUFFER   (1024 * 1024)
+
+// the library's default control point wants the sketch's tables; this program doesn't use it
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+class Office {
+public:
+	Office(int address) {
+		_address = address;
+		_nlines = 0;
+		_listen = -1;
+		memset(_state, 0, sizeof(_state));
+		memset(_known, 0, sizeof(_known));
+		memset(_changed, 0, sizeof(_changed));
+		packets = ignored = events = batches = dropped = 0;
+	}
+	~Office(void) {
+		for (int x = 0; x < _nlines; x++) delete _cp[x];
+		for (Sub &s : _subs) close(s.fd);
+		if (_listen >= 0) close(_listen);
+	}
+
+	int  line(CodeLine *l) {
+		if (_nlines == CTC_MAXLINES) return -1;
+		// address 0: this end takes every packet; we filter on the destination ourselves
+		_cp[_nlines] = new ControlPoint(0, _nlines, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+		_cp[_nlines]->codeline(l);
+		_line[_nlines] = l;
+		return _nlines++;
+	}
+	boolean listen(const char *path);
+	void    subscribe(int fd);
+	int     batch(void);				// returns # frames applied
+	int     control(int cp, int *controls);
+	void    wait(int ms);
+
+	long    packets;		// applied
+	long    ignored;		// not for us
+	long    events;			// I lines produced
+	long    batches;
+	long    dropped;		// subscribers that fell behind
+
+private:
+	struct Sub {
+		int         fd;
+		std::string in;
+		std::string out;
+	};
+	void    publish(int cp, byte mask, std::string &to);
+	void    serve(Sub &s);
+	void    command(Sub &s, const char *cmd);
+
+	int           _address;
+	int           _nlines;
+	CodeLine     *_line[CTC_MAXLINES];
+	ControlPoint *_cp[CTC_MAXLINES];
+	int           _listen;
+	std::vector<Sub> _subs;
+
+	// the packed state table
+	byte          _state[CTC_MAXCPS][8];
+	unsigned long _known[CTC_MAXCPS / 32];	// heard from at least once
+	byte          _changed[CTC_MAXCPS];		// bytes changed this batch
+	std::vector<int> _dirty;				// control points with _changed != 0
+};
+
+boolean Office::listen(const char *path) {
+	struct sockaddr_un a;
+	memset(&a, 0, sizeof(a));
+	a.sun_family = AF_UNIX;
+	strncpy(a.sun_path, path, sizeof(a.sun_path) - 1);
+	unlink(path);
+	_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_listen < 0 || bind(_listen, (struct sockaddr *)&a, sizeof(a)) < 0 || ::listen(_listen, 8) < 0) return false;
+	fcntl(_listen, F_SETFL, fcntl(_listen, F_GETFL) | O_NONBLOCK);
+	return true;
+}
+
+void Office::subscribe(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	Sub s;
+	s.fd = fd;
+	_subs.push_back(s);
+}
+
+void Office::publish(int cp, byte mask, std::string &to) {
+	char buf[64];
+	byte *b = _state[cp];
+	int n = snprintf(buf, sizeof(buf), "I %d %02X %02X %02X %02X %02X %02X %02X %02X %02X\n",
+	                 cp, b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], mask);
+	to.append(buf, n);
+}
+
+int Office::batch(void) {
+	int src, dst, ind[8];
+	int applied = 0;
+
+	// 1. apply everything waiting, noting what changed
+	for (int l = 0; l < _nlines; l++) {
+		for (int n = 0; n < CTC_BATCH; n++) {
+			unsigned long before = _cp[l]->frames();
+			if (!_cp[l]->receive(&src, &dst, ind)) {
+				if (_cp[l]->frames() == before) break;		// nothing waiting
+				ignored++;		// an advert or other traffic - there may be more behind it
+				continue;
+			}
+			if (_address && dst != _address && !ControlPoint::isGroup(dst)) {
+				ignored++;
+				continue;
+			}
+			int cp = l * CTC_PERLINE + (src & 0x7F);
+			byte *b = _state[cp];
+			byte mask = 0;
+			for (int x = 0; x < 8; x++) {
+				if (b[x] != (byte)ind[x]) {
+					b[x] = ind[x];
+					mask |= 1 << x;
+				}
+			}
+			if (!bitRead(_known[cp / 32], cp % 32)) {
+				bitSet(_known[cp / 32], cp % 32);
+				mask = 0xFF;
+			}
+			if (mask) {
+				if (!_changed[cp]) _dirty.push_back(cp);
+				_changed[cp] |= mask;
+			}
+			applied++;
+		}
+	}
+	packets += applied;
+
+	// 2. one event per changed control point, formatted once for everybody
+	if (!_dirty.empty()) {
+		std::string ev;
+		for (int cp : _dirty) {
+			publish(cp, _changed[cp], ev);
+			_changed[cp] = 0;
+		}
+		events += _dirty.size();
+		_dirty.clear();
+		for (Sub &s : _subs) s.out += ev;
+	}
+	if (applied) batches++;
+
+	// 3. subscribers: new ones, their commands, and their output
+	if (_listen >= 0) {
+		int fd;
+		while ((fd = accept(_listen, NULL, NULL)) >= 0) subscribe(fd);
+	}
+	for (size_t x = 0; x < _subs.size(); ) {
+		serve(_subs[x]);
+		if (_subs[x].fd < 0) {
+			_subs.erase(_subs.begin() + x);
+		} else {
+			x++;
+		}
+	}
+	for (int l = 0; l < _nlines; l++) _line[l]->flush();
+	return applied;
+}
+
+void Office::serve(Sub &s) {
+	char buf[4096];
+	int got;
+	while ((got = read(s.fd, buf, sizeof(buf))) > 0) s.in.append(buf, got);
+	if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		close(s.fd);
+		s.fd = -1;
+		return;
+	}
+	size_t eol;
+	while ((eol = s.in.find('\n')) != std::string::npos) {
+		std::string cmd = s.in.substr(0, eol);
+		s.in.erase(0, eol + 1);
+		command(s, cmd.c_str());
+	}
+	while (!s.out.empty()) {
+		int put = ::send(s.fd, s.out.data(), s.out.size(), MSG_NOSIGNAL);
+		if (put > 0) {
+			s.out.erase(0, put);
+		} else if (put < 0 && errno == EINTR) {
+			continue;
+		} else {
+			break;
+		}
+	}
+	if (s.out.size() > CTC_SUBBUFFER) {		// not keeping up
+		close(s.fd);
+		s.fd = -1;
+		dropped++;
+	}
+}
+
+void Office::command(Sub &s, const char *cmd) {
+	if (cmd[0] == 'S') {
+		for (int cp = 0; cp < CTC_MAXCPS; cp++) {
+			if (bitRead(_known[cp / 32], cp % 32)) publish(cp, 0xFF, s.out);
+		}
+	} else if (cmd[0] == 'C') {
+		int cp;
+		unsigned int c[8];
+		if (sscanf(cmd + 1, "%d %x %x %x %x %x %x %x %x", &cp, &c[0], &c[1], &c[2], &c[3], &c[4], &c[5], &c[6], &c[7]) == 9) {
+			int controls[8];
+			for (int x = 0; x < 8; x++) controls[x] = c[x] & 0xFF;
+			control(cp, controls);
+		}
+	}
+}
+
+int Office::control(int cp, int *controls) {
+	int l = cp / CTC_PERLINE;
+	if (cp < 0 || l >= _nlines) return LN_UNKNOWN_ERROR;
+	return _cp[l]->send(_address, cp % CTC_PERLINE, controls);
+}
+
+void Office::wait(int ms) {
+	struct pollfd p[CTC_MAXLINES + 64];
+	int n = 0;
+	for (int l = 0; l < _nlines; l++) {
+		if (_line[l]->waiting()) return;		// already have more to do
+		if (_line[l]->fd() >= 0) { p[n].fd = _line[l]->fd(); p[n].events = POLLIN; n++; }
+	}
+	if (_listen >= 0) { p[n].fd = _listen; p[n].events = POLLIN; n++; }
+	for (Sub &s : _subs) {
+		if (n == (int)(sizeof(p) / sizeof(p[0]))) break;
+		p[n].fd = s.fd;
+		p[n].events = POLLIN | (s.out.empty() ? 0 : POLLOUT);
+		n++;
+	}
+	::poll(p, n, ms);		// lines still waiting for a peer to connect are picked up on the timeout
+}
+
+/*
+ * Synthetic traffic: each packet is from a random control point; most change
+ * a bit or two of its indications, the rest repeat the last state the way a
+ * periodic refresh would.
+ */
+static int generate(const char *file, int ncps, long npackets) {
+	int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(file);
+		return 1;
+	}
+	if (ncps < 1) ncps = 1;
+	if (ncps > CTC_PERLINE - 2) ncps = CTC_PERLINE - 2;
+	FdCodeLine out(fd);
+	ControlPoint gen(0, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+	gen.codeline(&out);
+
+	std::mt19937 rng(1);
+	std::vector<int> ind(ncps * 8, 0);
+	for (long p = 0; p < npackets; p++) {
+		int c = rng() % ncps;
+		int *i = &ind[c * 8];
+		if (rng() % 5) {
+			int flips = 1 + rng() % 2;
+			while (flips--) i[rng() % 8] ^= 1 << (rng() % 8);
+		}
+		while (gen.send(c + 2, 1, i) != LN_DONE) out.flush();	// CPs 2..127, office is 1
+	}
+	out.flush();
+	return 0;
+}
+
+static int replay(std::vector<const char *> &files, int nsubs) {
+	Office office(1);
+	std::vector<std::string> data;
+	std::vector<size_t> sent;
+	std::vector<int> feed;
+	std::vector<FdCodeLine *> lines;
+
+	long expected = 0;
+	for (const char *file : files) {
+		FILE *f = fopen(file, "rb");
+		if (!f) {
+			perror(file);
+			return 1;
+		}
+		std::string d;
+		char buf[65536];
+		size_t got;
+		while ((got = fread(buf, 1, sizeof(buf), f)) > 0) d.append(buf, got);
+		fclose(f);
+		expected += d.size() / 16;
+		data.push_back(d);
+		sent.push_back(0);
+
+		int sv[2];
+		socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+		fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+		feed.push_back(sv[0]);
+		lines.push_back(new FdCodeLine(sv[1]));
+		office.line(lines.back());
+	}
+	std::vector<int> subs;
+	for (int x = 0; x < nsubs; x++) {
+		int sv[2];
+		socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+		fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+		subs.push_back(sv[0]);
+		office.subscribe(sv[1]);
+	}
+
+	long received = 0;
+	char buf[65536];
+	auto t0 = std::chrono::steady_clock::now();
+	while (office.packets + office.ignored < expected) {
+		for (size_t f = 0; f < feed.size(); f++) {
+			if (sent[f] < data[f].size()) {
+				int put = write(feed[f], data[f].data() + sent[f], data[f].size() - sent[f]);
+				if (put > 0) sent[f] += put;
+			}
+		}
+		office.batch();
+		for (int fd : subs) {
+			int got;
+			while ((got = read(fd, buf, sizeof(buf))) > 0) {
+				for (int x = 0; x < got; x++) received += (buf[x] == '\n');
+			}
+		}
+	}
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	printf("%zu lines, %ld packets in %.3f s: %.0f packets/s, %.2f us/packet\n",
+	       files.size(), office.packets, s, office.packets / s, s * 1e6 / office.packets);
+	printf("%ld batches (%.1f packets each), %ld events (%.1f%% of packets), %ld lines delivered to %d subscribers\n",
+	       office.batches, office.batches ? (double)office.packets / office.batches : 0.0,
+	       office.events, 100.0 * office.events / office.packets, received, nsubs);
+	for (int fd : subs) close(fd);
+	for (int fd : feed) close(fd);
+	return 0;
+}
+
+static int serve(int argc, char **argv) {
+	int address = 1;
+	const char *subpath = "/tmp/ctcoffice";
+	std::vector<CodeLine *> lines;
+
+	for (int a = 1; a < argc; a++) {
+		if (!strcmp(argv[a], "-a") && a + 1 < argc) {
+			address = atoi(argv[++a]);
+		} else if (!strcmp(argv[a], "-s") && a + 1 < argc) {
+			subpath = argv[++a];
+		} else if (!strcmp(argv[a], "-l") && a + 1 < argc) {
+			lines.push_back(new UnixCodeLine(argv[++a], true));
+		} else if (!strcmp(argv[a], "-p")) {
+			PtyCodeLine *p = new PtyCodeLine();
+			printf("line %zu: %s\n", lines.size(), p->name());
+			lines.push_back(p);
+		}
+	}
+	if (lines.empty()) {
+		fprintf(stderr, "no field lines (-l socket or -p)\n");
+		return 1;
+	}
+	Office office(address);
+	for (CodeLine *l : lines) office.line(l);
+	if (!office.listen(subpath)) {
+		perror(subpath);
+		return 1;
+	}
+	printf("office %d, subscribers on %s\n", address, subpath);
+	fflush(stdout);
+	for (;;) {
+		if (!office.batch()) office.wait(10);
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc > 4 && !strcmp(argv[1], "-g")) {
+		return generate(argv[2], atoi(argv[3]), atol(argv[4]));
+	}
+	if (argc > 2 && !strcmp(argv[1], "-r")) {
+		std::vector<const char *> files;
+		int nsubs = 1;
+		for (int a = 2; a < argc; a++) {
+			if (!strcmp(argv[a], "-n") && a + 1 < argc) {
+				nsubs = atoi(argv[++a]);
+			} else {
+				files.push_back(argv[a]);
+			}
+		}
+		return replay(files, nsubs);
+	}
+	return serve(argc, argv);
+}
@@ -0,0 +1,629 @@
+/*
+ * Multi control point layout simulator
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Runs many simulated control points - each a real ControlPoint with its own
+ * device tables and EEPROM slot - on one in-memory LocoNet segment, and
+ * reports how the codeline holds up as the number of control points grows.
+ *
+ * Build (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make layoutsim                 (in tools/, makes build/layoutsim)
+ *
+ * The host EEPROM needs CP_EEPROM_SLOTSIZE bytes per control point.
+ *
+ * Use:     layoutsim [threads] [simulated seconds] [#CPs ...]
+ *          layoutsim 4 600 12 24 48 60 96
+ *
+ * Model
+ *
+ *  Time moves in fixed 5 ms scan rounds.  In each round every control point
+ *  runs one pass of the usual sketch loop:
+ *      LnPacket2Controls (receive), apply, savestate, readall,
+ *      evaluate (only the heads whose inputs changed), writeall,
+ *      advertiseAspects, sendCodeLine
+ *  spread across a work stealing thread pool.  Between rounds the coordinator
+ *  moves trains and switch points, lets the dispatcher code control points,
+ *  and runs the bus.
+ *
+ *  The bus is LocoNet at 16.66 kbps: 60 us per bit, 10 bits per byte, so a
+ *  16 byte OPC_PEER_XFER occupies the line for 9.6 ms.  A node may start only
+ *  after the line has been idle for the 20 bit carrier detect backoff plus its
+ *  own priority delay.  Nodes starting within one bit time of each other
+ *  collide; the collision is detected within a byte, followed by a 15 bit
+ *  break, and the losers retry with a new random priority.  Every frame that
+ *  makes it is seen by every node.
+ *
+ *  The control points stand in a row.  Each head follows the exit head of
+ *  the neighbour it leads to, so aspects propagate along the line: "settle"
+ *  is the time from an aspect change until the last advertisement it caused
+ *  was delivered, and "hops" the longest such chain.
+ *
+ *  Everything random is drawn by the coordinator from seeded generators, so
+ *  the results do not depend on the number of threads.
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#define BIT_US          60UL		// 16.66 kbps
+#define FRAME_BITS      160UL		// 16 bytes, 10 bits each
+#define CD_BITS         20UL		// carrier detect backoff
+#define PRIO_BITS       20			// max random priority delay
+#define COLLISION_BITS  (10UL + 15UL)	// detect within a byte, then break
+#define SCAN_US         5000UL		// one scan of every control point
+#define THROW_US        3000000UL	// switch points take 3 seconds
+#define DISPATCHER      1			// codeline address of the cTc office
+#define FIRSTCP         10			// first control point address
+#define STARTUP_US      2000000UL	// everyone advertises everything at first; leave that out of the settling times
+
+// the library's default control point wants the sketch's tables; this program doesn't use it
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+/*
+ * Simulated time, shared by everything; only the coordinator moves it
+ */
+static unsigned long long simus = 0;
+static unsigned long simMillis(void) { return (unsigned long)(simus / 1000ULL); }
+
+/*
+ * A frame, as it appears on (or waits for) the bus
+ */
+struct Frame {
+	lnMsg              msg;
+	unsigned long long queued;		// when the sender handed it over
+	int                from;		// node index, 0 = dispatcher
+	// aspect advertisements: the change that started the cascade this one is part of
+	unsigned long long origin;
+	int                originCP;
+	int                hops;
+};
+
+static boolean isAdvert(lnMsg *msg) { return (msg->data[3] | (msg->data[4] << 7)) == CP_ASPECTADDRESS; }
+
+/*
+ * One control point: the device tables a sketch would declare, plus the
+ * layout it is wired to.
+ */
+struct SimCP;
+static thread_local SimCP *current;		// the one being scanned on this thread
+
+class SimLine : public CodeLine {
+public:
+	SimLine(SimCP *cp) : c(cp) { }
+	lnMsg *receive(void);
+	int    send(lnMsg *msg);
+private:
+	SimCP *c;
+};
+
+static TrackCircuit::State getTrack(const char *name);
+static Switch::State       getPoints(const char *name);
+static void                setHead(const char *name, RRSignalHead::Aspects a, int bit1, int bit2);
+
+struct SimCP {
+	// device tables
+	TrackCircuit tracks[3] = { TrackCircuit("WA", getTrack), TrackCircuit("OS", getTrack), TrackCircuit("EA", getTrack) };
+	Switch       sws[1]    = { Switch((char *)"W1", getPoints, NULL) };
+	RRSignal     sigs[1]   = { RRSignal("S2") };
+	RRSignalHead heads[2]  = { RRSignalHead("2L", &sigs[0], setHead), RRSignalHead("2R", &sigs[0], setHead) };
+	ControlPoint cp;
+	SimLine      line;
+
+	// the layout
+	TrackCircuit::State occupancy[3];
+	Switch::State       points;
+	Switch::State       pointsTarget;
+	unsigned long long  pointsDone;
+	int                 trainPhase;
+	unsigned long long  trainNext;
+
+	// codeline
+	std::vector<Frame>  outbox;		// written by this CP's scan, drained by the bus
+	size_t              inbox;		// cursor into the frames delivered last round
+	int                 prio;
+	unsigned long long  codeQueued;	// dispatcher coded us at...
+	boolean             codeDelivered;
+	int                 headbits[2];
+	long                outputChanges;
+	boolean             heardAd;		// this scan; what the cascade it belongs to is
+	unsigned long long  adOrigin;
+	int                 adOriginCP;
+	int                 adHops;
+	std::mt19937        rng;
+
+	SimCP(int n) : cp(FIRSTCP + n, n, NULL, 0, tracks, 3, sws, 1, sigs, 1, heads, 2, NULL, 0), line(this), rng(n + 1) {
+		occupancy[0] = occupancy[1] = occupancy[2] = TrackCircuit::EMPTY;
+		points = pointsTarget = Switch::NORMAL;
+		pointsDone = 0;
+		trainPhase = 0;
+		trainNext = (rng() % 120) * 1000000ULL;
+		inbox = 0;
+		prio = rng() % PRIO_BITS;
+		codeQueued = 0;
+		codeDelivered = false;
+		headbits[0] = headbits[1] = -1;
+		outputChanges = 0;
+		sws[0].controls(0, 1);
+		sigs[0].controls(2, 3);
+		sws[0].indications(0, 1);
+		sigs[0].indications(2, 3);
+		for (int x = 0; x < 3; x++) tracks[x].indication(4 + x);
+		heads[0].setRoutes((void *)routesL);
+		heads[1].setRoutes((void *)routesR);
+		heads[0].advertise(true);
+		heads[1].advertise(true);
+		sigs[0].set(RRSignal::ALLSTOP);		// come up at stop, or no code would ever be accepted
+		heardAd = false;
+	}
+	// the control points are in a row: 2L leads toward n + 1, 2R toward n - 1
+	void chain(int n, int ncps) {
+		if (n + 1 < ncps) heads[0].follow(FIRSTCP + n + 1, 0);
+		if (n > 0)        heads[1].follow(FIRSTCP + n - 1, 1);
+	}
+	int  address(void)     { return cp.address(); }
+	void scan(void);
+};
+
+static TrackCircuit::State getTrack(const char *name) {
+	return current->occupancy[name[0] == 'W' ? 0 : name[0] == 'O' ? 1 : 2];
+}
+static Switch::State getPoints(const char *name) {
+	return current->points;
+}
+static void setHead(const char *name, RRSignalHead::Aspects a, int bit1, int bit2) {
+	int h = (name[1] == 'L') ? 0 : 1;
+	int bits = (bit1 << 1) | bit2;
+	if (bits != current->headbits[h]) {
+		current->headbits[h] = bits;
+		current->outputChanges++;
+	}
+}
+
+/*
+ * The CodeLine each simulated control point talks through instead of LocoNet
+ */
+static std::vector<Frame> delivered;	// everything that made it onto the bus last round
+
+lnMsg *SimLine::receive(void) {
+	if (c->inbox < delivered.size()) {
+		Frame &f = delivered[c->inbox++];
+		if (isAdvert(&f.msg) && f.from != c->address() - FIRSTCP + 1 && (!c->heardAd || f.origin < c->adOrigin)) {
+			c->heardAd    = true;
+			c->adOrigin   = f.origin;
+			c->adOriginCP = f.originCP;
+			c->adHops     = f.hops;
+		}
+		return &f.msg;
+	}
+	return NULL;
+}
+int SimLine::send(lnMsg *msg) {
+	Frame f;
+	f.msg = *msg;
+	f.queued = simus;
+	f.from = c->address() - FIRSTCP + 1;
+	if (c->heardAd) {		// we're passing on a change we heard about
+		f.origin   = c->adOrigin;
+		f.originCP = c->adOriginCP;
+		f.hops     = c->adHops + 1;
+	} else {
+		f.origin   = simus;
+		f.originCP = f.from;
+		f.hops     = 0;
+	}
+	c->outbox.push_back(f);
+	return LN_DONE;
+}
+
+/*
+ * One pass of the sketch's loop()
+ *
+ * Control packet:    controls[0] bit 0,1 = switch N,R   bit 2,3 = signal L,R (both = all stop)
+ * Indication packet: indications[0] bit 0,1 = switch N,R   bit 2,3 = signal L,R   bit 4,5,6 = WA,OS,EA
+ */
+static void evaluateHead(int h) {
+	SimCP *c = current;
+	RRSignal &s = c->sigs[0];
+	RRSignalHead::Aspects a = (RRSignalHead::Aspects)(h == 0 ? s.LeftAspect() : s.RightAspect());
+	if (a == RRSignalHead::CLEAR && c->tracks[h == 0 ? 0 : 2].isOccupied()) a = RRSignalHead::RESTRICTING;
+	c->heads[h].set(a);
+}
+
+void SimCP::scan(void) {
+	int src, dst, controls[8];
+	boolean coded = false;
+	heardAd = false;
+
+	while (inbox < delivered.size()) {
+		int r = cp.receive(&src, &dst, controls);
+		if (r == 2 || (r == 1 && dst == address())) {
+			if (cp.apply(controls) == ControlPoint::ACCEPTED) {
+				cp.save(controls);
+			}
+			coded = true;
+		}
+	}
+
+	cp.read();
+
+	// vital logic
+	RRSignal &s = sigs[0];
+	if (tracks[1].isOccupied()) {
+		s.knockdown();
+	} else if (!s.isRunningTime() && sws[0].is(sws[0].commanded()) && s.reported() != s.commanded()) {
+		s.report();
+	}
+	cp.evaluate(evaluateHead);
+	cp.write();
+	cp.advertise();
+
+	int ind[8], changed[8];
+	if (cp.indications(ind, changed) || coded) {
+		cp.send(DISPATCHER, ind);
+	}
+}
+
+/*
+ * Work stealing pool: each worker owns a deque of control points, takes from
+ * its front, and steals from the back of the others' when it runs dry.
+ */
+class Pool {
+public:
+	Pool(int n) : _queues(n), _locks(n) {
+		for (int x = 0; x < n; x++) _threads.push_back(std::thread(&Pool::worker, this, x));
+	}
+	~Pool() {
+		{ std::lock_guard<std::mutex> g(_mu); _quit = true; _gen++; }
+		_go.notify_all();
+		for (auto &t : _threads) t.join();
+	}
+	void run(std::vector<SimCP *> &cps) {
+		_cps = &cps;
+		_left = (int)cps.size();
+		for (size_t x = 0; x < cps.size(); x++) {
+			int q = x % _queues.size();
+			std::lock_guard<std::mutex> g(_locks[q]);
+			_queues[q].push_back((int)x);
+		}
+		{ std::lock_guard<std::mutex> g(_mu); _gen++; }
+		_go.notify_all();
+		std::unique_lock<std::mutex> g(_mu);
+		_done.wait(g, [this] { return _left.load() == 0; });
+	}
+	long steals(void) { return _steals; }
+private:
+	boolean take(int me, int *task) {
+		{
+			std::lock_guard<std::mutex> g(_locks[me]);
+			if (!_queues[me].empty()) {
+				*task = _queues[me].front();
+				_queues[me].pop_front();
+				return true;
+			}
+		}
+		for (size_t k = 1; k < _queues.size(); k++) {
+			int victim = (me + k) % _queues.size();
+			std::lock_guard<std::mutex> g(_locks[victim]);
+			if (!_queues[victim].empty()) {
+				*task = _queues[victim].back();
+				_queues[victim].pop_back();
+				_steals++;
+				return true;
+			}
+		}
+		return false;
+	}
+	void worker(int me) {
+		long seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> g(_mu);
+				_go.wait(g, [&] { return _gen != seen; });
+				seen = _gen;
+				if (_quit) return;
+			}
+			int task;
+			while (take(me, &task)) {
+				current = (*_cps)[task];
+				current->scan();
+				if (--_left == 0) {
+					std::lock_guard<std::mutex> g(_mu);
+					_done.notify_one();
+				}
+			}
+		}
+	}
+	std::vector<std::deque<int> > _queues;
+	std::vector<std::mutex>       _locks;
+	std::vector<std::thread>      _threads;
+	std::vector<SimCP *>         *_cps = NULL;
+	std::mutex                    _mu;
+	std::condition_variable       _go, _done;
+	std::atomic<int>              _left { 0 };
+	std::atomic<long>             _steals { 0 };
+	long                          _gen = 0;
+	boolean                       _quit = false;
+};
+
+/*
+ * The bus, plus the dispatcher as node 0
+ */
+struct Cascade {
+	unsigned long long last;		// when its last advertisement was delivered
+	int                hops;
+};
+
+struct Stats {
+	unsigned long long busy;
+	long frames, collisions, codes, codesAnswered, adverts;
+	std::map<std::pair<int, unsigned long long>, Cascade> cascades;	// by where and when it started
+	std::vector<unsigned long> indLatency;		// us, queued -> on the wire
+	std::vector<unsigned long> codeLatency;		// us, code queued -> indication delivered
+};
+
+struct Bus {
+	std::vector<SimCP *> *cps;
+	std::vector<Frame>    dispatcher;
+	int                   dispatcherPrio;
+	std::mt19937          rng;
+	boolean               busy;
+	boolean               collision;
+	unsigned long long    busyUntil;
+	unsigned long long    idleSince;
+	Frame                 onWire;
+	Stats                 st;
+
+	std::vector<Frame> &outbox(int node)    { return node ? (*cps)[node - 1]->outbox : dispatcher; }
+	int                &prio(int node)      { return node ? (*cps)[node - 1]->prio : dispatcherPrio; }
+
+	void deliver(Frame &f, std::vector<Frame> &out) {
+		st.frames++;
+		out.push_back(f);
+		if (isAdvert(&f.msg)) {
+			st.adverts++;
+			if (f.origin >= STARTUP_US) {
+				Cascade &k = st.cascades[std::make_pair(f.originCP, f.origin)];
+				k.last = std::max(k.last, busyUntil);
+				k.hops = std::max(k.hops, f.hops);
+			}
+		} else if (f.from) {
+			st.indLatency.push_back((unsigned long)(busyUntil - f.queued));
+			SimCP *c = (*cps)[f.from - 1];
+			if (c->codeQueued && c->codeDelivered) {
+				st.codeLatency.push_back((unsigned long)(busyUntil - c->codeQueued));
+				st.codesAnswered++;
+				c->codeQueued = 0;
+			}
+		} else {
+			int to = (f.msg.data[3] | (f.msg.data[4] << 7)) - FIRSTCP;
+			if (to >= 0 && to < (int)cps->size() && (*cps)[to]->codeQueued) {
+				(*cps)[to]->codeDelivered = true;
+			}
+		}
+	}
+
+	// run the bus up to "end", collecting what got through
+	void advance(unsigned long long end, std::vector<Frame> &out) {
+		int nodes = cps->size() + 1;
+		for (;;) {
+			if (busy) {
+				if (busyUntil > end) return;
+				if (!collision) deliver(onWire, out);
+				busy = false;
+				idleSince = busyUntil;
+			}
+			unsigned long long first = ~0ULL;
+			for (int n = 0; n < nodes; n++) {
+				std::vector<Frame> &q = outbox(n);
+				if (q.empty()) continue;
+				unsigned long long s = std::max(idleSince, q.front().queued) + (CD_BITS + prio(n)) * BIT_US;
+				first = std::min(first, s);
+			}
+			if (first >= end) return;		// nobody gets the line this round
+
+			std::vector<int> starters;
+			for (int n = 0; n < nodes; n++) {
+				std::vector<Frame> &q = outbox(n);
+				if (q.empty()) continue;
+				unsigned long long s = std::max(idleSince, q.front().queued) + (CD_BITS + prio(n)) * BIT_US;
+				if (s < first + BIT_US) starters.push_back(n);
+			}
+			busy = true;
+			if (starters.size() == 1) {
+				int n = starters[0];
+				onWire = outbox(n).front();
+				outbox(n).erase(outbox(n).begin());
+				prio(n) = rng() % PRIO_BITS;
+				collision = false;
+				busyUntil = first + FRAME_BITS * BIT_US;
+			} else {
+				for (int n : starters) prio(n) = rng() % PRIO_BITS;
+				st.collisions++;
+				collision = true;
+				busyUntil = first + COLLISION_BITS * BIT_US;
+			}
+			st.busy += busyUntil - first;
+		}
+	}
+};
+
+/*
+ * Trains and switch points, moved by the coordinator between rounds
+ */
+static void moveLayout(SimCP *c) {
+	Switch::State cmd = c->sws[0].commanded();
+	if (cmd == Switch::NORMAL || cmd == Switch::REVERSE) c->pointsTarget = cmd;
+	if (c->pointsTarget != c->points && c->pointsDone == 0) {
+		c->pointsDone = simus + THROW_US;
+	}
+	if (c->pointsDone && simus >= c->pointsDone) {
+		c->points = c->pointsTarget;
+		c->pointsDone = 0;
+	}
+	if (simus < c->trainNext) return;
+	// WA -> WA+OS -> OS -> OS+EA -> EA -> gone
+	static const unsigned char occ[6] = { 1, 3, 2, 6, 4, 0 };
+	static const unsigned long secs[6] = { 30, 5, 10, 5, 30, 60 };
+	int p = c->trainPhase;
+	for (int x = 0; x < 3; x++) {
+		c->occupancy[x] = bitRead(occ[p], x) ? TrackCircuit::OCCUPIED : TrackCircuit::EMPTY;
+	}
+	c->trainNext = simus + (secs[p] + c->rng() % (secs[p] + 1)) * 1000000ULL;
+	c->trainPhase = (p + 1) % 6;
+}
+
+static ControlPoint office;		// the dispatcher's end of the codeline
+
+class OfficeLine : public CodeLine {
+public:
+	lnMsg *receive(void)     { return NULL; }		// the sim reads the dispatcher's mail itself
+	int    send(lnMsg *msg) {
+		Frame f;
+		f.msg = *msg;
+		f.queued = simus;
+		f.from = 0;
+		bus->dispatcher.push_back(f);
+		return LN_DONE;
+	}
+	Bus   *bus;
+};
+static OfficeLine officeLine;
+
+static void codeOne(Bus &bus, SimCP *c) {
+	// alternate between lining the switch reverse with the signal cleared, and normal with all stop
+	int controls[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	if (c->sws[0].commanded() == Switch::NORMAL) {
+		controls[0] = B0010 | B0100;				// R, signal left
+	} else {
+		controls[0] = B0001 | B0100 | B1000;		// N, all stop
+	}
+	office.send(DISPATCHER, c->address(), controls);
+	c->codeQueued = simus;
+	c->codeDelivered = false;
+	bus.st.codes++;
+}
+
+static unsigned long percentile(std::vector<unsigned long> &v, double p) {
+	if (v.empty()) return 0;
+	size_t k = (size_t)(p * (v.size() - 1));
+	std::nth_element(v.begin(), v.begin() + k, v.end());
+	return v[k];
+}
+static double average(std::vector<unsigned long> &v) {
+	double sum = 0;
+	for (unsigned long x : v) sum += x;
+	return v.empty() ? 0 : sum / v.size();
+}
+
+static void simulate(int ncps, int threads, unsigned long seconds) {
+	std::vector<SimCP *> cps;
+	for (int n = 0; n < ncps; n++) {
+		SimCP *c = new SimCP(n);
+		c->cp.codeline(&c->line);
+		c->chain(n, ncps);
+		cps.push_back(c);
+	}
+	simus = 0;
+	for (SimCP *c : cps) {
+		current = c;
+		c->cp.begin();
+	}
+
+	Bus bus;
+	bus.cps = &cps;
+	bus.dispatcherPrio = 0;
+	bus.rng.seed(12345);
+	bus.busy = bus.collision = false;
+	bus.busyUntil = bus.idleSince = 0;
+	bus.st.busy = 0;
+	bus.st.frames = bus.st.collisions = bus.st.codes = bus.st.codesAnswered = bus.st.adverts = 0;
+	std::mt19937 dispatch(4242);
+	officeLine.bus = &bus;
+	office.codeline(&officeLine);
+
+	Pool pool(threads);
+	std::vector<Frame> next;
+	unsigned long long end = seconds * 1000000ULL;
+	long rounds = 0;
+	auto t0 = std::chrono::steady_clock::now();
+
+	while (simus < end) {
+		for (SimCP *c : cps) c->inbox = 0;
+		pool.run(cps);
+		rounds++;
+
+		// the dispatcher codes, on average, one control point every 10 seconds per 12 control points
+		if (dispatch() % (2000 * 12 / ncps + 1) == 0) {
+			codeOne(bus, cps[dispatch() % ncps]);
+		}
+		for (SimCP *c : cps) moveLayout(c);
+
+		next.clear();
+		bus.advance(simus + SCAN_US, next);
+		delivered.swap(next);
+		simus += SCAN_US;
+	}
+
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	long backlog = bus.dispatcher.size();
+	long outputs = 0;
+	for (SimCP *c : cps) { backlog += c->outbox.size(); outputs += c->outputChanges; }
+	std::vector<unsigned long> settle;
+	int hops = 0;
+	for (auto &k : bus.st.cascades) {
+		settle.push_back((unsigned long)(k.second.last - k.first.second));
+		hops = std::max(hops, k.second.hops);
+	}
+
+	printf("%5d %7d %8.1f %8.2f %10.0f %8.0fx %7.1f%% %7ld %6ld %8.1f %8.1f %8.1f %9.1f %9.1f %7ld %8ld %7ld %10.1f %10.1f %4d\n",
+		ncps, threads, (double)seconds, wall,
+		rounds * (double)ncps / wall,
+		seconds / wall,
+		100.0 * bus.st.busy / end,
+		bus.st.frames, bus.st.collisions,
+		average(bus.st.indLatency) / 1000.0,
+		percentile(bus.st.indLatency, 0.99) / 1000.0,
+		percentile(bus.st.indLatency, 1.0) / 1000.0,
+		average(bus.st.codeLatency) / 1000.0,
+		percentile(bus.st.codeLatency, 1.0) / 1000.0,
+		backlog, outputs,
+		bus.st.adverts, average(settle) / 1000.0, percentile(settle, 1.0) / 1000.0, hops);
+	fflush(stdout);
+
+	for (SimCP *c : cps) delete c;
+}
+
+int main(int argc, char **argv) {
+	int threads = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+	unsigned long seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : 600;
+	if (threads < 1) threads = 1;
+
+	Clock::use(simMillis);
+
+	printf("  CPs threads    sim s   wall s    scans/s  speedup bus util  frames  coll. "
+	       "ind avg  ind p99  ind max  code avg  code max backlog  outputs adverts settle avg settle max hops\n");
+	if (argc > 3) {
+		for (int a = 3; a < argc; a++) simulate(atoi(argv[a]), threads, seconds);
+	} else {
+		static const int sizes[] = { 12, 24, 36, 48, 60, 96 };
+		for (int n : sizes) simulate(n, threads, seconds);
+	}
+	return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Record, print and replay codeline captures (see Capture.h for the format)
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Build (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make lncapture                 (in tools/, makes build/lncapture)
+ *
+ *      add -DLAYOUT='"mylayout.h"' to replay through your own control point
+ *      instead of the built in one (see below)
+ *
+ * Use:     lncapture record <serial device | UNIX socket> capture
+ *                  record everything a LocoNet serial bridge (57600 baud, raw)
+ *                  or a CodeLine socket sees, until interrupted
+ *          lncapture print capture
+ *          lncapture replay capture output [golden]
+ *                  feed the frames this end received back through the sketch loop
+ *                  - LnPacket2Controls, applyControls, readall, evaluateall,
+ *                  writeall, buildIndications, sendCodeLine - in virtual time,
+ *                  write the indications it sends as a new capture, and if a
+ *                  golden capture is given, compare the two.  Exit status is
+ *                  1 if they differ.
+ *
+ * Replay runs as fast as the code allows: time jumps straight to the next
+ * captured frame or the next switch / signal timer, whichever comes first,
+ * so an evening's operating session takes seconds.  Only the codeline is
+ * in a capture; detectors stay where the layout file puts them.  The
+ * control point starts from an erased EEPROM, as on a new board.
+ *
+ * A LAYOUT file provides what the sketch would: the m[], track[], sw[], sig[],
+ * head[] and mc[] tables and their getNum...() functions, a layout() function
+ * for the setup() time calls (controls(), indications(), setRoutes()...), the
+ * vital() logic run after readall() (knockdown, report...), the evaluate(int head)
+ * function given to evaluateall(), and ME and OFFICE, the codeline addresses of
+ * the control point and the dispatcher.
+ */
+
+#include <ControlPoint.h>
+#include <EEPROM.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#ifdef LAYOUT
+#include LAYOUT
+#else
+/*
+ * Built in layout: the interlocking in compat/HostLayout.h - a switch, a
+ * signal with two heads, and three track circuits.
+ *
+ * Control packet:    controls[0] bit 0,1 = switch N,R   bit 2,3 = signal L,R (both = all stop)
+ * Indication packet: indications[0] bit 0,1 = switch N,R   bit 2,3 = signal L,R   bit 4,5,6 = WA,OS,EA
+ */
+#define ME      10
+#define OFFICE  1
+
+#include <HostLayout.h>
+
+TrackCircuit::State layoutTrack(const char *name)  { return TrackCircuit::EMPTY; }
+Switch::State       layoutPoints(const char *name) { return sw[0].commanded(); }	// points follow the controls
+
+static void layout(void) {
+	sw[0].controls(0, 1);
+	sig[0].controls(2, 3);
+	sw[0].indications(0, 1);
+	sig[0].indications(2, 3);
+	for (int x = 0; x < 3; x++) track[x].indication(4 + x);
+	head[0].setRoutes((void *)routesL);
+	head[1].setRoutes((void *)routesR);
+	sig[0].set(RRSignal::ALLSTOP);		// come up at stop
+}
+
+static void vital(void) {
+	if (track[1].isOccupied()) {
+		sig[0].knockdown();
+	} else if (!sig[0].isRunningTime() && sw[0].is(sw[0].commanded()) && sig[0].reported() != sig[0].commanded()) {
+		sig[0].report();
+	}
+}
+
+static void evaluate(int h) {
+	RRSignalHead::Aspects a = (RRSignalHead::Aspects)(h == 0 ? sig[0].LeftAspect() : sig[0].RightAspect());
+	if (a == RRSignalHead::CLEAR && track[h == 0 ? 0 : 2].isOccupied()) a = RRSignalHead::RESTRICTING;
+	head[h].set(a);
+}
+#endif
+
+#define SETTLE_MS  60000UL		// keep scanning this long after the last frame
+
+class FilePrint : public Print {
+public:
+	FilePrint(FILE *f)                            { _f = f; }
+	size_t write(uint8_t c)                       { return fputc(c, _f) != EOF; }
+	size_t write(const uint8_t *buf, size_t n)    { return fwrite(buf, 1, n, _f); }
+private:
+	FILE *_f;
+};
+
+struct Record {
+	unsigned long time;
+	boolean       sent;
+	lnMsg         msg;
+};
+
+static boolean load(const char *file, std::vector<Record> &records) {
+	FILE *f = fopen(file, "rb");
+	if (!f) {
+		perror(file);
+		return false;
+	}
+	byte hdr[4];
+	if (fread(hdr, 1, 4, f) != 4 || hdr[0] != 'L' || hdr[1] != 'N' || hdr[2] != 'C' || hdr[3] != CAPTURE_VERSION) {
+		fprintf(stderr, "%s: not a version %d capture\n", file, CAPTURE_VERSION);
+		fclose(f);
+		return false;
+	}
+	byte r[5];
+	while (fread(r, 1, 5, f) == 5) {
+		Record rec;
+		int len = r[0] & ~CAPTURE_SENT;
+		if (len < 2 || len > (int)sizeof(lnMsg)) break;
+		rec.sent = (r[0] & CAPTURE_SENT) != 0;
+		rec.time = r[1] | (r[2] << 8) | ((unsigned long)r[3] << 16) | ((unsigned long)r[4] << 24);
+		memset(&rec.msg, 0, sizeof(rec.msg));
+		if (fread(rec.msg.data, 1, len, f) != (size_t)len) break;
+		records.push_back(rec);
+	}
+	fclose(f);
+	return true;
+}
+
+static void show(Record &r, unsigned long start) {
+	printf("%10.3f %s ", (r.time - start) / 1000.0, r.sent ? "TX" : "RX");
+	int len = getLnMsgSize(&r.msg);
+	for (int x = 0; x < len; x++) printf(" %02X", r.msg.data[x]);
+	if (r.msg.data[0] == OPC_PEER_XFER) {
+		int src, dst, d[8];
+		src = r.msg.px.src;
+		dst = (r.msg.px.dst_l & 0x7F) | ((r.msg.px.dst_h & 0x7F) << 7);
+		byte *p = r.msg.data;
+		for (int x = 0; x < 4; x++) {
+			d[x]     = p[6 + x]  | ((p[5]  >> x) & 1) << 7;
+			d[4 + x] = p[11 + x] | ((p[10] >> x) & 1) << 7;
+		}
+		printf("   %d -> %d:", src, dst);
+		for (int x = 0; x < 8; x++) printf(" %02X", d[x]);
+	}
+	printf("\n");
+}
+
+static int print(const char *file) {
+	std::vector<Record> records;
+	if (!load(file, records)) return 1;
+	for (Record &r : records) show(r, records.empty() ? 0 : records[0].time);
+	return 0;
+}
+
+/*
+ * Record
+ */
+static volatile sig_atomic_t stop = 0;
+static void interrupted(int) { stop = 1; }
+
+static unsigned long hostMillis(void) {
+	static auto t0 = std::chrono::steady_clock::now();
+	return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static int record(const char *from, const char *file) {
+	struct stat st;
+	CodeLine *line;
+	if (stat(from, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		line = new UnixCodeLine(from, false);
+	} else {
+		int fd = open(from, O_RDWR | O_NOCTTY);
+		if (fd < 0) {
+			perror(from);
+			return 1;
+		}
+		struct termios t;
+		if (tcgetattr(fd, &t) == 0) {
+			cfmakeraw(&t);
+			cfsetspeed(&t, B57600);
+			tcsetattr(fd, TCSANOW, &t);
+		}
+		line = new FdCodeLine(fd);
+	}
+	FILE *f = fopen(file, "wb");
+	if (!f) {
+		perror(file);
+		return 1;
+	}
+	FilePrint out(f);
+	CaptureCodeLine cap(line, out);
+	Clock::use(hostMillis);
+	cap.begin();
+
+	signal(SIGINT, interrupted);
+	signal(SIGTERM, interrupted);
+	long n = 0;
+	while (!stop) {
+		if (cap.receive()) {
+			n++;
+		} else {
+			fflush(f);
+			usleep(2000);
+		}
+	}
+	fclose(f);
+	fprintf(stderr, "%ld frames\n", n);
+	return 0;
+}
+
+/*
+ * Replay
+ */
+class ReplayLine : public CodeLine {
+public:
+	ReplayLine(std::vector<Record> &in, Print &out) : _in(in), _out(out) { _next = 0; skipSent(); }
+	lnMsg *receive(void) {
+		if (_next < _in.size() && (long)(_in[_next].time - Clock::millis()) <= 0) {
+			lnMsg *m = &_in[_next++].msg;
+			skipSent();
+			return m;
+		}
+		return NULL;
+	}
+	int send(lnMsg *msg) {
+		CaptureCodeLine::record(_out, msg, true, Clock::millis());
+		sent++;
+		return LN_DONE;
+	}
+	boolean done(void)        { return _next >= _in.size(); }
+	unsigned long due(void)   { return _in[_next].time; }
+	long sent = 0;
+private:
+	void skipSent(void)       { while (_next < _in.size() && _in[_next].sent) _next++; }	// what the original sent is the answer, not the question
+	std::vector<Record> &_in;
+	Print               &_out;
+	size_t               _next;
+};
+
+static int replay(const char *file, const char *outfile, const char *golden) {
+	std::vector<Record> in;
+	if (!load(file, in)) return 1;
+	if (in.empty()) {
+		fprintf(stderr, "%s: empty\n", file);
+		return 1;
+	}
+	FILE *f = fopen(outfile, "wb");
+	if (!f) {
+		perror(outfile);
+		return 1;
+	}
+	FilePrint out(f);
+	CaptureCodeLine::header(out);
+	ReplayLine line(in, out);
+
+	Clock::virtualTime(in[0].time);
+	ControlPoint::defaultCP().codeline(&line);
+	layout();
+	// an erased EEPROM, so restore() finds no saved controls and every replay starts alike
+	for (int a = 0; a < EEPROM.length(); a++) EEPROM.write(a, 0xFF);
+	ControlPoint::setup();
+
+	unsigned long end = in.back().time + SETTLE_MS;
+	int  src, dst, controls[8], ind[8], changed[8];
+	long scans = 0, accepted = 0, refused = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (;;) {
+		// the sketch's loop()
+		boolean coded = false;
+		int r = ControlPoint::LnPacket2Controls(&src, &dst, controls);
+		if (r == 2 || (r == 1 && dst == ME)) {
+			if (ControlPoint::applyControls(controls) == ControlPoint::ACCEPTED) {
+				ControlPoint::savestate(controls);
+				accepted++;
+			} else {
+				refused++;
+			}
+			coded = true;
+		}
+		ControlPoint::readall();
+		vital();
+		ControlPoint::evaluateall(evaluate);
+		ControlPoint::writeall();
+		if (ControlPoint::buildIndications(ind, changed) || coded) ControlPoint::sendCodeLine(ME, OFFICE, ind);
+		scans++;
+
+		// on to whatever happens next
+		if (!line.done()) {
+			if ((long)(line.due() - Clock::millis()) <= 0) continue;
+			Clock::deadline(line.due());
+		}
+		if (!Clock::skip() || (long)(Clock::millis() - end) > 0) break;
+	}
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	fclose(f);
+
+	double session = (in.back().time - in[0].time) / 1000.0;
+	printf("%zu frames, %.1f s of codeline in %.3f s wall (%.0fx), %ld scans, "
+	       "%ld controls accepted, %ld refused, %ld indications sent\n",
+	       in.size(), session, s, s > 0 ? session / s : 0.0, scans, accepted, refused, line.sent);
+
+	if (!golden) return 0;
+	std::vector<Record> got, want;
+	if (!load(outfile, got) || !load(golden, want)) return 1;
+	for (size_t x = 0; x < got.size() || x < want.size(); x++) {
+		if (x >= got.size() || x >= want.size() || got[x].time != want[x].time ||
+		    memcmp(got[x].msg.data, want[x].msg.data, getLnMsgSize(&got[x].msg))) {
+			printf("DIFFERS from %s at indication %zu\n", golden, x);
+			if (x < want.size()) { printf("  want "); show(want[x], in[0].time); }
+			if (x < got.size())  { printf("  got  "); show(got[x], in[0].time); }
+			return 1;
+		}
+	}
+	printf("matches %s\n", golden);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 3 && !strcmp(argv[1], "record")) return record(argv[2], argv[3]);
+	if (argc > 2 && !strcmp(argv[1], "print"))  return print(argv[2]);
+	if (argc > 3 && !strcmp(argv[1], "replay")) return replay(argv[2], argv[3], argc > 4 ? argv[4] : NULL);
+	fprintf(stderr, "use: lncapture record <device|socket> capture\n"
+	                "     lncapture print capture\n"
+	                "     lncapture replay capture output [golden]\n");
+	return 2;
+}
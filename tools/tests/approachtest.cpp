@@ -0,0 +1,106 @@
+/*
+ * Host test of approach lighting
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * The interlocking in tools/compat/HostLayout.h, with head 2L lit by a
+ * train on EA and 2R always lit.  Checks that
+ *
+ *      - 2L stays dark at power up, while the tracks are still UNKNOWN,
+ *      - it lights when a train is on EA and goes dark when it leaves,
+ *      - a detector in ERROR lights it, as it might be hiding a train, and
+ *      - 2R, with no approach tracks, is never dark, and dark or lit
+ *        the heads keep their aspects.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+
+#include <HostLayout.h>
+
+// the world outside: what each detector says
+static TrackCircuit::State detector[3] = { TrackCircuit::EMPTY, TrackCircuit::EMPTY, TrackCircuit::EMPTY };
+
+TrackCircuit::State layoutTrack(const char *name) {
+	for (int x = 0; x < 3; x++) {
+		if (!strcmp(track[x].name(), name)) return detector[x];
+	}
+	return TrackCircuit::ERROR;
+}
+Switch::State layoutPoints(const char *name) { return Switch::NORMAL; }
+
+class NullCodeLine : public CodeLine {
+public:
+	lnMsg *receive(void)                  { return NULL; }
+	int    send(lnMsg *msg)               { return LN_DONE; }
+};
+static NullCodeLine nowhere;
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+static void evaluate(int h) { head[h].set(RRSignalHead::STOP); }
+
+// one pass of the sketch's loop
+static void scan(void) {
+	Clock::advance(100);
+	ControlPoint::readall();
+	ControlPoint::evaluateall(evaluate);
+	ControlPoint::writeall();
+}
+
+int main(int argc, char **argv) {
+	Clock::virtualTime(1000000UL);
+	ControlPoint::defaultCP().codeline(&nowhere);
+	head[0].approachLit(2);		// 2L: a train on EA
+	ControlPoint::setup(11);
+
+	// power up
+	CHECK("every track UNKNOWN before the first read", track[2].is(TrackCircuit::UNKNOWN), true);
+	CHECK("2L dark at power up", head[0].lit(), false);
+	CHECK("2R lit at power up", head[1].lit(), true);
+	scan();
+	CHECK("2L dark with EA empty", head[0].shown(), RRSignalHead::DARK);
+	CHECK("2R shows its aspect", head[1].shown(), RRSignalHead::STOP);
+
+	// a train comes and goes
+	detector[2] = TrackCircuit::OCCUPIED;
+	scan();
+	CHECK("2L lit with a train on EA", head[0].shown(), RRSignalHead::STOP);
+	detector[0] = TrackCircuit::OCCUPIED;
+	scan();
+	CHECK("a train on WA doesn't change that", head[0].lit(), true);
+	detector[2] = TrackCircuit::EMPTY;
+	scan();
+	CHECK("2L dark once EA is empty", head[0].lit(), false);
+	CHECK("whatever WA says", head[1].lit(), true);
+	CHECK("2L still has its aspect", head[0].is(RRSignalHead::STOP), true);
+
+	// a broken detector
+	detector[2] = TrackCircuit::ERROR;
+	scan();
+	CHECK("2L lit with EA in ERROR", head[0].lit(), true);
+	CHECK("EA occupied for the interlocking too", (ControlPoint::defaultCP().occupied() >> 2) & 1, 1);
+	detector[2] = TrackCircuit::EMPTY;
+	scan();
+	CHECK("2L dark once EA is fixed and empty", head[0].lit(), false);
+
+	if (failed) printf("approachtest: %d failed\n", failed);
+	else        printf("approachtest: passed\n");
+	return failed ? 1 : 0;
+}
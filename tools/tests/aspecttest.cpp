@@ -0,0 +1,139 @@
+/*
+ * Host test of aspect advertisements between control points
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Three control points in a row, each with one head: A (11) follows B
+ * (12), which follows C (13), the exit.  A and C share a board, B is on
+ * the other end of a QueueCodeLine.  Checks that
+ *
+ *      - a follower shows APPROACH until it hears from the next signal,
+ *      - a train at C gives B APPROACH and A ADVANCED_APPROACH, and it
+ *        clearing puts them back to CLEAR, each settling in one
+ *        advertisement per control point that changed,
+ *      - nothing is sent when nothing changed, and
+ *      - a control point that restarts asks, and hears the aspect again.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+
+// no default control point here, but the library wants the sketch's tables
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+static QueueCodeLine boardA, boardB;
+
+static RRSignalHead headA[1] = { RRSignalHead("A") };
+static RRSignalHead headB[1] = { RRSignalHead("B") };
+static RRSignalHead headC[1] = { RRSignalHead("C") };
+
+static ControlPoint cpA(11, 1, NULL, 0, NULL, 0, NULL, 0, NULL, 0, headA, 1, NULL, 0);
+static ControlPoint cpB(12, 2, NULL, 0, NULL, 0, NULL, 0, NULL, 0, headB, 1, NULL, 0);
+static ControlPoint cpC(13, 3, NULL, 0, NULL, 0, NULL, 0, NULL, 0, headC, 1, NULL, 0);
+
+static boolean trainAtC;	// C's own signal at stop
+
+static void evaluateA(int h) { headA[h].set(RRSignalHead::CLEAR); }
+static void evaluateB(int h) { headB[h].set(RRSignalHead::CLEAR); }
+static void evaluateC(int h) { headC[h].set(trainAtC ? RRSignalHead::STOP : RRSignalHead::CLEAR); }
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+static void take(ControlPoint &cp) {
+	int src, dst, data[8];
+	while (cp.receive(&src, &dst, data) || cp.codeline()->waiting()) { }
+}
+
+// one pass of each control point's loop; advertisements sent
+static int scan(void) {
+	int sent = 0;
+	take(cpA);
+	take(cpB);
+	take(cpC);
+	cpA.evaluate(evaluateA);
+	cpB.evaluate(evaluateB);
+	cpC.evaluate(evaluateC);
+	sent += cpA.advertise();
+	sent += cpB.advertise();
+	sent += cpC.advertise();
+	return sent;
+}
+
+// scan until nothing more is sent; advertisements it took, or -1 if it never stops
+static int settle(void) {
+	int sent = 0;
+	for (int x = 0; x < 10; x++) {
+		int n = scan();
+		if (!n) {
+			scan();			// the last one still has to be heard
+			return sent;
+		}
+		sent += n;
+	}
+	return -1;
+}
+
+int main(int argc, char **argv) {
+	boardA.connect(&boardB);
+	cpA.codeline(&boardA);
+	cpB.codeline(&boardB);
+	cpC.codeline(&boardA);
+	headA[0].follow(12, 0);
+	headB[0].follow(13, 0);
+	headB[0].advertise(true);
+	headC[0].advertise(true);
+
+	// before anyone hears anything
+	cpA.begin();
+	cpB.begin();
+	cpC.begin();
+	cpA.evaluate(evaluateA);
+	CHECK("A assumes B is at stop", headA[0].is(), RRSignalHead::APPROACH);
+	CHECK("advertisements to settle at power up", settle() >= 0, true);
+	CHECK("C clear", headC[0].is(), RRSignalHead::CLEAR);
+	CHECK("B clear", headB[0].is(), RRSignalHead::CLEAR);
+	CHECK("A clear", headA[0].is(), RRSignalHead::CLEAR);
+	CHECK("nothing to say once settled", scan(), 0);
+
+	// a train at C
+	trainAtC = true;
+	CHECK("advertisements for a train at C", settle(), 2);
+	CHECK("C at stop", headC[0].is(), RRSignalHead::STOP);
+	CHECK("B approach", headB[0].is(), RRSignalHead::APPROACH);
+	CHECK("A advanced approach", headA[0].is(), RRSignalHead::ADVANCED_APPROACH);
+
+	// and gone
+	trainAtC = false;
+	CHECK("advertisements for C clearing", settle(), 2);
+	CHECK("B clear again", headB[0].is(), RRSignalHead::CLEAR);
+	CHECK("A clear again", headA[0].is(), RRSignalHead::CLEAR);
+
+	// A restarts, knowing nothing: it asks, and B tells it again
+	headA[0].follow(12, 0);
+	cpA.begin();
+	cpA.evaluate(evaluateA);
+	CHECK("A back to approach", headA[0].is(), RRSignalHead::APPROACH);
+	CHECK("B's answer", settle(), 1);
+	CHECK("A clear once it's heard", headA[0].is(), RRSignalHead::CLEAR);
+
+	if (failed) printf("aspecttest: %d failed\n", failed);
+	else        printf("aspecttest: passed\n");
+	return failed ? 1 : 0;
+}
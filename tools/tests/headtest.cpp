@@ -0,0 +1,124 @@
+/*
+ * Host test of event driven head evaluation
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * The interlocking in tools/compat/HostLayout.h, with 2L's routes over
+ * W1, WA and OS and 2R's over W1, EA and OS.  Counts the heads
+ * evaluateall() hands to evaluate(), and checks that
+ *
+ *      - every head is evaluated once after setup(), and none on a scan
+ *        where nothing moved,
+ *      - a track circuit only brings in the heads whose routes name it,
+ *      - a switch or a signal brings in all of its heads, both when it is
+ *        told to move and when it gets there.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+
+#include <HostLayout.h>
+
+// the world outside: where the trains are, and where the points say they are
+static byte          trains[3];
+static Switch::State points = Switch::NORMAL;
+
+TrackCircuit::State layoutTrack(const char *name) {
+	for (int x = 0; x < 3; x++) {
+		if (!strcmp(track[x].name(), name)) return trains[x] ? TrackCircuit::OCCUPIED : TrackCircuit::EMPTY;
+	}
+	return TrackCircuit::ERROR;
+}
+Switch::State layoutPoints(const char *name) { return points; }
+
+class NullCodeLine : public CodeLine {
+public:
+	lnMsg *receive(void)                  { return NULL; }
+	int    send(lnMsg *msg)               { return LN_DONE; }
+};
+static NullCodeLine nowhere;
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+static int evaluated;		// bit per head given to evaluate() on the last scan
+
+static void evaluate(int h) {
+	bitSet(evaluated, h);
+	head[h].set(RRSignalHead::STOP);
+}
+
+// one pass of the sketch's loop, ms after the last; which heads it evaluated
+static int scan(unsigned long ms) {
+	Clock::advance(ms);
+	evaluated = 0;
+	ControlPoint::readall();
+	ControlPoint::evaluateall(evaluate);
+	ControlPoint::writeall();
+	return evaluated;
+}
+
+#define L2  (1 << 0)
+#define R2  (1 << 1)
+
+int main(int argc, char **argv) {
+	Clock::virtualTime(1000000UL);		// the clock only moves in scan()
+	ControlPoint::defaultCP().codeline(&nowhere);
+	head[0].setRoutes((void *)routesL);
+	head[1].setRoutes((void *)routesR);
+	ControlPoint::setup(11);
+
+	CHECK("first scan evaluates everything", scan(0), L2 | R2);
+	scan(100);
+	CHECK("nothing moved", scan(100), 0);
+
+	// track circuits: only the heads whose routes name them
+	trains[0] = 1;
+	CHECK("train on WA", scan(100), L2);
+	CHECK("and then nothing", scan(100), 0);
+	trains[2] = 1;
+	CHECK("train on EA", scan(100), R2);
+	trains[1] = 1;
+	CHECK("train on OS", scan(100), L2 | R2);
+	trains[0] = trains[1] = trains[2] = 0;
+	CHECK("all three clear", scan(100), L2 | R2);
+	CHECK("and then nothing", scan(100), 0);
+
+	// a switch: when it's told to move and when it gets there
+	sw[0].set(Switch::REVERSE);
+	CHECK("W1 told to go reverse", scan(100), L2 | R2);
+	points = Switch::REVERSE;
+	CHECK("W1 reverse", scan(100), L2 | R2);
+	CHECK("and then nothing", scan(100), 0);
+
+	// a signal: cleared, then back to stop when its running time is up
+	sig[0].set(RRSignal::LEFT);
+	CHECK("S2 cleared", scan(100), L2 | R2);
+	CHECK("and then nothing", scan(100), 0);
+	sig[0].set(RRSignal::ALLSTOP);
+	CHECK("S2 told to stop", scan(100), L2 | R2);
+	CHECK("nothing while it runs time", scan(5000), 0);
+	CHECK("its running time up", scan(6000), L2 | R2);
+	sig[0].report();
+	CHECK("S2 reports stop", scan(100), L2 | R2);
+	CHECK("and then nothing", scan(100), 0);
+
+	if (failed) printf("headtest: %d failed\n", failed);
+	else        printf("headtest: passed\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Host test of Lighting fades and scenes
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Two lights with callbacks and one on an I2Cextender bit, run in virtual
+ * time.  Checks that
+ *
+ *      - a fade follows its curve and ends exactly at its level, and the
+ *        output is only written when the level moves,
+ *      - an I2Cextender light is on from half brightness up, with one put()
+ *        per run for the port,
+ *      - scene steps happen at their times and a scene with a period
+ *        starts again from the top, and
+ *      - a run that uses up its budget stops, counts a short run, and the
+ *        next one starts with the lights it didn't get to.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+#include <Lighting.h>
+
+#include <stdio.h>
+
+// no default control point here, but the library wants the sketch's tables
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+static byte          level[2];		// what each callback light was last set to
+static int           writes[2];
+static unsigned long spin;			// us each callback takes
+
+static void setLevel(const char *name, byte l) {
+	int x = (name[0] == 'Y') ? 0 : 1;
+	level[x] = l;
+	writes[x]++;
+	unsigned long start = micros();
+	while (micros() - start < spin) { }
+}
+
+static I2Cextender ext;
+static Light       room[3] = { Light("YARD", setLevel), Light("DEPOT", setLevel), Light("TOWER", &ext, 2) };
+static Lighting    lights(room, 3);
+
+// the yard up at 0, the depot up at 1 s and down at 1.5 s, every 2 s
+const LightStep day[] PROGMEM = {
+	{    0, 0, 255, 0, Lighting::LINEAR },
+	{ 1000, 1, 200, 0, Lighting::LINEAR },
+	{ 1500, 1,   0, 0, Lighting::LINEAR },
+};
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+static boolean run(unsigned long ms) {
+	Clock::advance(ms);
+	return lights.run(0);
+}
+
+int main(int argc, char **argv) {
+	Clock::virtualTime(1000000UL);		// the clock only moves in run()
+
+	// a linear fade up, and back down
+	room[0].fade(255, 1600, Lighting::LINEAR);
+	run(0);
+	CHECK("at the start", level[0], 0);
+	run(800);
+	CHECK("half way up", level[0], 128);
+	CHECK("still fading", run(400), true);
+	CHECK("three quarters", level[0], 191);
+	CHECK("done", run(400), false);
+	CHECK("at its level", level[0], 255);
+	int was = writes[0];
+	run(100);
+	CHECK("nothing written once it's there", writes[0] - was, 0);
+	room[0].fade(0, 1600, Lighting::LINEAR);
+	run(0);
+	run(800);
+	CHECK("half way down", level[0], 127);
+	run(800);
+	CHECK("off", level[0], 0);
+
+	// the curve shapes it
+	room[0].fade(255, 1600, Lighting::EASE);
+	run(0);
+	run(400);
+	CHECK("a quarter of the way along EASE", level[0], 37);
+	run(1200);
+	CHECK("and all the way", level[0], 255);
+
+	// an I2Cextender light is on from 128 up
+	room[2].fade(255, 1600, Lighting::LINEAR);
+	run(0);
+	long puts = ext.puts;
+	run(700);
+	CHECK("tower off below half", bitRead(ext.output, 2), 0);
+	CHECK("one put() for the run", ext.puts - puts, 1);
+	run(100);
+	CHECK("tower on at half", bitRead(ext.output, 2), 1);
+	run(800);
+	puts = ext.puts;
+	run(100);
+	CHECK("no put() once it's done", ext.puts - puts, 0);
+
+	// a scene, every 2 s
+	room[0].set(0);
+	room[1].set(0);
+	run(0);
+	lights.scene(day, 3, 2000);
+	run(0);
+	CHECK("yard up at 0", level[0], 255);
+	CHECK("depot not yet", level[1], 0);
+	run(999);
+	CHECK("depot not before 1 s", level[1], 0);
+	run(1);
+	CHECK("depot up at 1 s", level[1], 200);
+	run(500);
+	CHECK("and down at 1.5 s", level[1], 0);
+	room[0].set(0);
+	run(400);
+	CHECK("yard stays down until the scene repeats", level[0], 0);
+	run(100);
+	CHECK("yard up again at 2 s", level[0], 255);
+	run(1000);
+	CHECK("depot up again at 3 s", level[1], 200);
+	lights.stop();
+	room[1].set(0);
+	run(2000);
+	CHECK("nothing after stop()", level[1], 0);
+
+	// running out of budget
+	room[0].set(100);
+	room[1].set(100);
+	spin = 2000;
+	unsigned int shortRuns = lights.shortRuns();
+	int yard = writes[0], depot = writes[1];
+	CHECK("a run over budget", lights.run(1000), true);
+	CHECK("counted", lights.shortRuns() - shortRuns, 1);
+	CHECK("got to one light", (writes[0] - yard) + (writes[1] - depot), 1);
+	spin = 0;
+	lights.run(1000);
+	CHECK("and the other next time", (writes[0] - yard) + (writes[1] - depot), 2);
+	CHECK("yard there", level[0], 100);
+	CHECK("depot there", level[1], 100);
+
+	if (failed) printf("lightingtest: %d failed\n", failed);
+	else        printf("lightingtest: passed\n");
+	return failed ? 1 : 0;
+}
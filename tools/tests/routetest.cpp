@@ -0,0 +1,156 @@
+/*
+ * Host test of ControlPoint::apply() and route locking
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Runs the real Switch, RRSignal, Route and ControlPoint code against the
+ * interlocking in tools/compat/HostLayout.h - a switch, a signal with two
+ * heads, three track circuits and four routes - and checks that
+ *
+ *      - a control packet is applied all or nothing,
+ *      - a signal is only cleared over a route that is lined, empty and
+ *        doesn't conflict with one already locked,
+ *      - a locked route's switches refuse to move, and
+ *      - a cleared signal can always be put back to stop, and
+ *      - the route is released when its signal is back at stop and the
+ *        train has cleared it.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+
+#include <HostLayout.h>
+
+// the world outside: where the trains are, and where the points say they are
+static byte          trains[3];
+static Switch::State points = Switch::NORMAL;
+
+TrackCircuit::State layoutTrack(const char *name) {
+	for (int x = 0; x < 3; x++) {
+		if (!strcmp(track[x].name(), name)) return trains[x] ? TrackCircuit::OCCUPIED : TrackCircuit::EMPTY;
+	}
+	return TrackCircuit::ERROR;
+}
+Switch::State layoutPoints(const char *name) { return points; }
+
+class NullCodeLine : public CodeLine {
+public:
+	lnMsg *receive(void)                  { return NULL; }
+	int    send(lnMsg *msg)               { return LN_DONE; }
+};
+static NullCodeLine nowhere;
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+// a control packet: switch W1 and signal S2, each NORMAL/REVERSE, LEFT/RIGHT/ALLSTOP or 0 = no change
+static byte request(Switch::State w1, RRSignal::State s2) {
+	int controls[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	if (w1 == Switch::NORMAL  || w1 == Switch::ERROR)     PUTBIT(controls, 0, 1);
+	if (w1 == Switch::REVERSE || w1 == Switch::ERROR)     PUTBIT(controls, 1, 1);
+	if (s2 == RRSignal::LEFT  || s2 == RRSignal::ALLSTOP) PUTBIT(controls, 2, 1);
+	if (s2 == RRSignal::RIGHT || s2 == RRSignal::ALLSTOP) PUTBIT(controls, 3, 1);
+	return ControlPoint::applyControls(controls);
+}
+
+// scan until the points and the signal have caught up, running time included
+static void settle(void) {
+	for (int x = 0; x < 4; x++) {
+		Clock::advance(15000);
+		ControlPoint::readall();
+		if (track[1].isOccupied() || !sw[0].is(sw[0].target())) {		// tools/cpcheck.cpp's vital()
+			sig[0].knockdown();
+		} else if (!sig[0].isRunningTime() && sig[0].reported() != sig[0].commanded()) {
+			sig[0].report();
+		}
+	}
+}
+
+static void reset(void) {
+	trains[0] = trains[1] = trains[2] = 0;
+	points = Switch::NORMAL;
+	ControlPoint::setup(11);
+	sw[0].set(Switch::NORMAL);
+	sig[0].set(RRSignal::ALLSTOP);
+	settle();
+}
+
+int main(int argc, char **argv) {
+	Clock::virtualTime(1000000UL);		// the clock only moves in settle()
+	ControlPoint::defaultCP().codeline(&nowhere);
+	sw[0].controls(0, 1);
+	sig[0].controls(2, 3);
+	ControlPoint::routeTable(route, 4);
+
+	// lining and locking a route
+	reset();
+	CHECK("clear 2L over W1 normal", request(Switch::NORMAL, RRSignal::LEFT), ControlPoint::ACCEPTED);
+	CHECK("route 2L-N locked", ControlPoint::defaultCP().locked(), 1 << 0);
+	CHECK("S2 commanded left", sig[0].target(), RRSignal::LEFT);
+	settle();
+	CHECK("W1 under a locked route", request(Switch::REVERSE, RRSignal::UNKNOWN), ControlPoint::LOCKED);
+	CHECK("W1 stays normal", sw[0].target(), Switch::NORMAL);
+	CHECK("2R while 2L is clear", request(Switch::UNKNOWN, RRSignal::RIGHT) != ControlPoint::ACCEPTED, 1);
+	CHECK("route 2L-N still locked", ControlPoint::defaultCP().locked(), 1 << 0);
+
+	// and releasing it behind a train
+	trains[1] = 1;
+	settle();
+	CHECK("train knocks S2 down", sig[0].reported(), RRSignal::ALLSTOP);
+	CHECK("S2 to stop", request(Switch::UNKNOWN, RRSignal::ALLSTOP), ControlPoint::ACCEPTED);
+	settle();
+	CHECK("route held while OS is occupied", ControlPoint::defaultCP().locked(), 1 << 0);
+	CHECK("W1 under the train", request(Switch::REVERSE, RRSignal::UNKNOWN), ControlPoint::LOCKED);
+	trains[1] = 0;
+	settle();
+	CHECK("route released once OS is empty", ControlPoint::defaultCP().locked(), 0);
+	CHECK("W1 free again", request(Switch::REVERSE, RRSignal::UNKNOWN), ControlPoint::ACCEPTED);
+	CHECK("W1 going reverse", sw[0].target(), Switch::REVERSE);
+
+	// the dispatcher cancels a cleared signal before any train gets to it
+	reset();
+	CHECK("clear 2R over W1 normal", request(Switch::NORMAL, RRSignal::RIGHT), ControlPoint::ACCEPTED);
+	settle();
+	CHECK("S2 cleared right", sig[0].reported(), RRSignal::RIGHT);
+	CHECK("cancel the clear signal", request(Switch::UNKNOWN, RRSignal::ALLSTOP), ControlPoint::ACCEPTED);
+	CHECK("S2 commanded to stop", sig[0].target(), RRSignal::ALLSTOP);
+	settle();
+	CHECK("S2 at stop after running time", sig[0].reported(), RRSignal::ALLSTOP);
+	CHECK("route released with the approach empty", ControlPoint::defaultCP().locked(), 0);
+	CHECK("W1 free again", request(Switch::REVERSE, RRSignal::UNKNOWN), ControlPoint::ACCEPTED);
+
+	// all or nothing: a bad signal request keeps the switch where it is
+	reset();
+	trains[1] = 1;
+	settle();
+	CHECK("clear 2L into an occupied OS", request(Switch::REVERSE, RRSignal::LEFT) & ControlPoint::LOCKED, ControlPoint::LOCKED);
+	CHECK("nothing locked", ControlPoint::defaultCP().locked(), 0);
+	CHECK("W1 not moved by the refused packet", sw[0].target(), Switch::NORMAL);
+	CHECK("S2 still at stop", sig[0].target(), RRSignal::ALLSTOP);
+	trains[1] = 0;
+	settle();
+
+	// nor does a bad switch request clear the signal
+	CHECK("bad switch request", request(Switch::ERROR, RRSignal::LEFT) & ControlPoint::BADSWITCH, ControlPoint::BADSWITCH);
+	CHECK("S2 not cleared by the refused packet", sig[0].target(), RRSignal::ALLSTOP);
+	CHECK("nothing locked", ControlPoint::defaultCP().locked(), 0);
+
+	if (failed) printf("routetest: %d failed\n", failed);
+	else        printf("routetest: passed\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Host test of the Scheduler
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Runs a 5 ms and a 20 ms task, an on demand one and two background ones
+ * in virtual time, and checks that
+ *
+ *      - periodic tasks run on their release grid, in the order they were
+ *        added, and tell Clock when they are next due,
+ *      - background tasks take turns, and only when nothing else is due,
+ *      - an on demand task runs once per trigger(),
+ *      - a task that sleeps through its releases counts them as missed
+ *        and skips them, rather than running them back to back, and
+ *      - a task over its budget is counted as an overrun.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+#include <Scheduler.h>
+
+#include <stdio.h>
+
+// no default control point here, but the library wants the sketch's tables
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+static Scheduler tasks;
+static byte      fast, slow, demand, bg1, bg2;
+
+static char      order[64];		// which tasks ran, in order, since the last forget()
+static int       ran;
+static unsigned long spin;		// us the slow task takes
+
+static void did(char c)      { if (ran < (int)sizeof(order) - 1) order[ran++] = c; order[ran] = '\0'; }
+static void fastTask(void)   { did('f'); }
+static void slowTask(void)   { did('s');
+                               unsigned long start = micros();
+                               while (micros() - start < spin) { } }
+static void demandTask(void) { did('d'); }
+static void bg1Task(void)    { did('1'); }
+static void bg2Task(void)    { did('2'); }
+static void forget(void)     { ran = 0; order[0] = '\0'; }
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+#define CHECKS(what, got, want)	checks(__LINE__, what, got, want)
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+static void checks(int line, const char *what, const char *got, const char *want) {
+	if (!strcmp(got, want)) return;
+	printf("line %d: %s: got \"%s\", want \"%s\"\n", line, what, got, want);
+	failed++;
+}
+
+int main(int argc, char **argv) {
+	Clock::virtualTime(1000000UL);
+	fast   = tasks.every(5, fastTask);
+	slow   = tasks.every(20, slowTask, 1000);
+	demand = tasks.onDemand(demandTask);
+	bg1    = tasks.background(bg1Task);
+	bg2    = tasks.background(bg2Task);
+
+	// both periodic tasks are due at once, and run in order
+	tasks.run();
+	CHECKS("first pass", order, "fs");
+	CHECK("next release reported", Clock::skip(), true);
+	CHECK("which is the fast task's", Clock::millis(), 1000005UL);
+
+	// a millisecond at a time for 40 ms, from there
+	forget();
+	for (int x = 0; x < 40; x++) {
+		if (x) Clock::advance(1);
+		tasks.run();
+	}
+	CHECK("fast task runs", tasks.runs(fast), 1 + 8);
+	CHECK("slow task runs", tasks.runs(slow), 1 + 2);
+	CHECKS("background only in between, taking turns", order, "f1212f1212f1212fs1212f1212f1212f1212fs1212");
+	CHECK("nothing started late", tasks.late(fast) + tasks.late(slow), 0);
+	CHECK("nothing missed", tasks.missed(fast) + tasks.missed(slow), 0);
+
+	// on demand
+	forget();
+	tasks.trigger(demand);
+	Clock::advance(1);
+	tasks.run();
+	tasks.run();
+	CHECKS("on demand, once per trigger", order, "fd1");
+
+	// sleeping through releases
+	tasks.clear();
+	forget();
+	Clock::advance(50);					// the fast task was due in 5, the slow one in 15
+	tasks.run();
+	CHECKS("one run each after 50 ms asleep", order, "fs");
+	CHECK("fast task's releases skipped", tasks.missed(fast), 9);
+	CHECK("slow task's", tasks.missed(slow), 1);
+	CHECK("fast task's start, ms after release", tasks.late(fast), 45);
+	forget();
+	Clock::advance(4);
+	tasks.run();
+	CHECKS("nothing due before the grid", order, "2");
+	Clock::advance(1);
+	tasks.run();
+	CHECKS("and back on it", order, "2fs");
+
+	// over budget
+	tasks.clear();
+	spin = 3000;
+	while (!tasks.runs(slow)) {
+		Clock::advance(1);
+		tasks.run();
+	}
+	CHECK("slow task over its 1 ms budget", tasks.overruns(slow), 1);
+	CHECK("and how far", tasks.worst(slow) >= 3000, true);
+	CHECK("fast task has no budget", tasks.overruns(fast), 0);
+
+	if (failed) printf("schedulertest: %d failed\n", failed);
+	else        printf("schedulertest: passed\n");
+	return failed ? 1 : 0;
+}
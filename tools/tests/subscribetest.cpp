@@ -0,0 +1,195 @@
+/*
+ * Host test of indication subscriptions
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Two boards joined by a QueueCodeLine: a publisher (12) and a local
+ * listener (11) on one, a remote listener (13) on the other.  Checks that
+ *
+ *      - subscribe() reaches the publisher both over the codeline and on
+ *        the same board, and unsubscribe() takes it back out,
+ *      - publish() sends nothing when the only bits that moved are ones
+ *        no subscriber's filter wants, and one group packet otherwise,
+ *      - the group packet gets to both listeners,
+ *      - a control point at address 0 can't subscribe or publish, and
+ *      - group indications queued for a listener can't crowd out the
+ *        controls sent to it.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+
+// no default control point here, but the library wants the sketch's tables
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+static QueueCodeLine boardA, boardB;
+
+static ControlPoint publisher(12, 1, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+static ControlPoint local(11, 2, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+static ControlPoint remote(13, 3, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+static ControlPoint nobody(0, 4, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0);
+
+// what each control point's receive() handed back
+struct Got {
+	int count;
+	int src, dst;
+	int data[8];
+};
+static Got gotPublisher, gotLocal, gotRemote, gotNobody;
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+static void take(ControlPoint &cp, Got *g) {
+	int src, dst, data[8];
+	for (;;) {
+		if (cp.receive(&src, &dst, data) == 1) {
+			g->count++;
+			g->src = src;
+			g->dst = dst;
+			for (int x = 0; x < 8; x++) g->data[x] = data[x];
+		} else if (!cp.codeline()->waiting()) {
+			return;
+		}
+	}
+}
+
+// let everything on both codelines be received
+static void pump(void) {
+	for (int x = 0; x < 4; x++) {
+		take(publisher, &gotPublisher);
+		take(local, &gotLocal);
+		take(remote, &gotRemote);
+		take(nobody, &gotNobody);
+	}
+}
+
+static void forget(void) {
+	memset(&gotPublisher, 0, sizeof(Got));
+	memset(&gotLocal, 0, sizeof(Got));
+	memset(&gotRemote, 0, sizeof(Got));
+	memset(&gotNobody, 0, sizeof(Got));
+}
+
+int main(int argc, char **argv) {
+	const byte byte0bit0[8] = { 0x01, 0, 0, 0, 0, 0, 0, 0 };
+	const byte byte1[8]     = { 0, 0xFF, 0, 0, 0, 0, 0, 0 };
+	int ind[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	boardA.connect(&boardB);
+	publisher.codeline(&boardA);
+	local.codeline(&boardA);
+	remote.codeline(&boardB);
+	nobody.codeline(&boardB);
+	publisher.begin();
+	local.begin();
+	remote.begin();
+	nobody.begin();
+	pump();
+
+	// subscribing, over the codeline and on the same board
+	CHECK("remote subscribes", remote.subscribe(12, byte0bit0), true);
+	pump();
+	CHECK("local subscribes", local.subscribe(12, byte1), true);
+	pump();
+	CHECK("publisher's subscribers", publisher.subscribers(), 2);
+	CHECK("remote listens", remote.listens(12), true);
+
+	// a new subscriber gets everything
+	forget();
+	CHECK("first publish", publisher.publish(ind), 1);
+	pump();
+	CHECK("remote got the group packet", gotRemote.count, 1);
+	CHECK("from the publisher", gotRemote.src, 12);
+	CHECK("to its group", gotRemote.dst, ControlPoint::group(12));
+	CHECK("local got it too", gotLocal.count, 1);
+	CHECK("local's was the group packet", gotLocal.dst, ControlPoint::group(12));
+	CHECK("the publisher's own receive() sees none", gotPublisher.count, 0);
+	CHECK("nor does a control point that didn't subscribe", gotNobody.count, 0);
+
+	// filtering
+	forget();
+	ind[0] = 0x02;
+	CHECK("a bit nobody wants", publisher.publish(ind), 0);
+	ind[0] = 0x03;
+	CHECK("a bit remote wants", publisher.publish(ind), 1);
+	pump();
+	CHECK("remote got it", gotRemote.count, 1);
+	CHECK("with the indications", gotRemote.data[0], 0x03);
+	ind[1] = 0x40;
+	CHECK("a bit local wants", publisher.publish(ind), 1);
+	CHECK("nothing moved", publisher.publish(ind), 0);
+	pump();
+	CHECK("remote got the second as well", gotRemote.count, 2);
+	CHECK("local got both", gotLocal.count, 2);
+
+	// unsubscribing
+	remote.unsubscribe(12);
+	pump();
+	CHECK("publisher's subscribers after unsubscribe", publisher.subscribers(), 1);
+	ind[0] = 0x01;
+	CHECK("remote's bit after unsubscribe", publisher.publish(ind), 0);
+
+	// a subscriber reusing remote's slot doesn't inherit its filter, even if
+	// the first half of its subscription (bytes 0-4) never arrives
+	int second[8] = { 2, 12, 5, 0x01, 0, 0, 0, 0 };		// SUBSCRIBE to 12, bytes 5-7 (see ControlPoint::enroll)
+	remote.send(13, CP_ASPECTADDRESS, second);
+	pump();
+	CHECK("publisher's subscribers after half a subscription", publisher.subscribers(), 2);
+	CHECK("the newcomer gets everything", publisher.publish(ind), 1);
+	pump();
+	ind[0] = 0x00;
+	CHECK("remote's old bit in the reused slot", publisher.publish(ind), 0);
+	ind[5] = 0x01;
+	CHECK("the bit it asked for", publisher.publish(ind), 1);
+	pump();
+	remote.unsubscribe(12);
+	pump();
+
+	// address 0 is nobody
+	CHECK("subscribe from address 0", nobody.subscribe(12, NULL), false);
+	CHECK("publish from address 0", nobody.publish(ind), 0);
+	CHECK("subscriber at address 0", publisher.subscriber(0, NULL), false);
+	pump();
+	CHECK("publisher's subscribers after address 0", publisher.subscribers(), 1);
+
+	// a full group queue doesn't cost local its controls
+	forget();
+	unsigned int dropped = local.dropped();
+	for (int x = 0; x < CP_HANDOFF + 1; x++) {
+		ind[1] ^= 0x01;
+		publisher.publish(ind);
+	}
+	CHECK("group packets local had no room for", local.dropped() - dropped, 1);
+	int controls[8] = { 0x55, 0, 0, 0, 0, 0, 0, 0 };
+	remote.send(11, controls);
+	take(publisher, &gotPublisher);		// picks up local's controls off the codeline and hands them over
+	CHECK("controls taken in all the same", local.dropped() - dropped, 1);
+	int src, dst, data[8];
+	CHECK("local's next packet", local.receive(&src, &dst, data), 1);
+	CHECK("is the controls", dst, 11);
+	CHECK("from remote", src, 13);
+	CHECK("with the controls", data[0], 0x55);
+	pump();
+	CHECK("then the group packets", gotLocal.count, CP_HANDOFF);
+
+	if (failed) printf("subscribetest: %d failed\n", failed);
+	else        printf("subscribetest: passed\n");
+	return failed ? 1 : 0;
+}
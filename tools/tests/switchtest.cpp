@@ -0,0 +1,137 @@
+/*
+ * Host test of switch point feedback and slow motion
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * One control point with one switch whose points report where they are,
+ * driven through read() and write() the way a sketch's loop does.  Checks
+ * that
+ *
+ *      - a throw drives the points at once and finishes when they report in,
+ *      - a throw taken back before the points move drives them back, and
+ *        the switch never leaves where it is,
+ *      - points that don't get there within the timeout put the switch in
+ *        ERROR until they report where they were sent, and
+ *      - without feedback, a slow motion throw takes its fixed time.
+ *
+ * Build and run (host, against the Arduino compatibility layer in tools/compat):
+ *
+ *      make test                    (in tools/)
+ *
+ *          exit status 0 = all passed, 1 = something failed
+ */
+
+#include <ControlPoint.h>
+
+#include <stdio.h>
+
+// no default control point here, but the library wants the sketch's tables
+#define EMPTY_LAYOUT
+#include <HostLayout.h>
+
+#define TIMEOUT  5000		// ms the points get to report in
+
+// the points: where they are, and where the control point last drove them
+static Switch::State points = Switch::UNKNOWN;
+static Switch::State driven = Switch::UNKNOWN;
+static int           drives;
+
+static Switch::State getPoints(const char *name)          { return points; }
+static void          setPoints(const char *name, Switch::State s) { driven = s; drives++; }
+
+static Switch        w1[1] = { Switch((char *)"W1", getPoints, setPoints) };
+static ControlPoint  board(11, 1, NULL, 0, NULL, 0, w1, 1, NULL, 0, NULL, 0, NULL, 0);
+
+static int failed;
+
+#define CHECK(what, got, want)	check(__LINE__, what, (long)(got), (long)(want))
+
+static void check(int line, const char *what, long got, long want) {
+	if (got == want) return;
+	printf("line %d: %s: got %ld, want %ld\n", line, what, got, want);
+	failed++;
+}
+
+// one pass of the sketch's loop, ms after the last
+static void scan(unsigned long ms) {
+	Clock::advance(ms);
+	board.read();
+	board.write();
+}
+
+int main(int argc, char **argv) {
+	Clock::virtualTime(1000000UL);		// the clock only moves in scan()
+	w1[0].feedback(TIMEOUT);
+	points = Switch::NORMAL;
+	board.begin();
+	scan(0);
+	CHECK("W1 comes up normal", w1[0].is(), Switch::NORMAL);
+	CHECK("and is driven there", driven, Switch::NORMAL);
+
+	// a throw finishes when the points get there
+#ifdef CP_STATS
+	unsigned int throws = w1[0].throws();	// begin() drove it normal, and that counts
+#endif
+	w1[0].set(Switch::REVERSE);
+	scan(0);
+	CHECK("points driven reverse", driven, Switch::REVERSE);
+	CHECK("W1 on its way", w1[0].commanded(), Switch::TIME);
+	scan(1000);
+	CHECK("W1 still on its way", w1[0].commanded(), Switch::TIME);
+	CHECK("indicating normal meanwhile", w1[0].is(), Switch::NORMAL);
+	points = Switch::REVERSE;
+	scan(200);
+	CHECK("W1 reverse as soon as the points report", w1[0].is(), Switch::REVERSE);
+	CHECK("throw finished", w1[0].commanded(), Switch::REVERSE);
+#ifdef CP_STATS
+	CHECK("one throw counted", w1[0].throws() - throws, 1);
+	CHECK("taking the time it took", w1[0].throwMax(), 1200);
+#endif
+
+	// and one taken back before the points move drives them back
+	w1[0].set(Switch::NORMAL);
+	scan(0);
+	CHECK("points driven normal", driven, Switch::NORMAL);
+	scan(500);
+	int was = drives;
+	w1[0].set(Switch::REVERSE);
+	CHECK("W1 told it's already there", w1[0].commanded(), Switch::REVERSE);
+	scan(0);
+	CHECK("points driven reverse again", driven, Switch::REVERSE);
+	CHECK("once", drives - was, 1);
+	scan(TIMEOUT + 1000);
+	CHECK("W1 stays reverse", w1[0].is(), Switch::REVERSE);
+	CHECK("with no throw running", w1[0].isRunning(), false);
+
+	// points that don't get there
+	w1[0].set(Switch::NORMAL);
+	scan(0);
+	scan(TIMEOUT + 1);
+	CHECK("stuck points are an ERROR", w1[0].is(), Switch::ERROR);
+	CHECK("still driven normal", driven, Switch::NORMAL);
+	points = Switch::UNKNOWN;
+	scan(100);
+	CHECK("and stay one in between", w1[0].is(), Switch::ERROR);
+	points = Switch::NORMAL;
+	scan(100);
+	CHECK("until they report where they were sent", w1[0].is(), Switch::NORMAL);
+#ifdef CP_STATS
+	CHECK("timeout counted", w1[0].timeouts(), 1);
+#endif
+
+	// without feedback a throw takes its fixed time, and the points are only driven after it
+	w1[0].feedback(0);
+	w1[0].setSlowMotion(3, Switch::REVERSE);
+	scan(0);
+	scan(2000);
+	CHECK("not there before its time", w1[0].commanded(), Switch::TIME);
+	CHECK("points not driven yet", driven, Switch::NORMAL);
+	scan(1001);
+	CHECK("there after it", w1[0].commanded(), Switch::REVERSE);
+	CHECK("points driven reverse", driven, Switch::REVERSE);
+
+	if (failed) printf("switchtest: %d failed\n", failed);
+	else        printf("switchtest: passed\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Host side decoder for the Trace.h binary event ring
+ *
+ *    Copyright (c) 2013-2015 John Plocher
+ *    Attribution-NonCommercial-ShareAlike 4.0 International (CC BY-NC-SA 4.0)
+ *
+ * Build:   c++ -O2 -o tracedump tracedump.cpp
+ * Use:     tracedump [capturefile]        (reads stdin if no file given)
+ *
+ * e.g.     stty -F /dev/ttyUSB0 57600 raw; cat /dev/ttyUSB0 | tracedump
+ *
+ * The 16 bit millisecond timestamps are unwrapped, so times are relative
+ * to the first event seen and keep counting past 65 seconds.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+// MUST be the SAME as Trace.h's version
+enum Event { NONE, TRACK, SWITCH, SWITCHCMD, SIGNAL, KNOCKDOWN, TIME, ASPECT, RX, TX, EEPROMWRITE, MARK, ROUTE, DROP, NOADDRESS, FULL };
+
+// MUST be the SAME as the enums in TrackCircuit.h, Switch.h, RRSignal.h and RRSignalHead.h
+static const char *trackStates[]  = { "UNKNOWN", "EMPTY", "OCCUPIED", "ERROR" };
+static const char *switchStates[] = { "UNKNOWN", "NORMAL", "REVERSE", "TIME", "ERROR" };
+static const char *signalStates[] = { "UNKNOWN", "LEFT", "RIGHT", "ALLSTOP", "TIME", "ERROR" };
+static const char *aspects[]      = { "CLEAR", "LIMITED_CLEAR", "ADVANCED_APPROACH", "APPROACH", "RESTRICTING", "STOP", "DARK" };
+static const char *messages[]     = { "ADVERTISE", "ASK", "SUBSCRIBE", "UNSUBSCRIBE", "RENEW", "PUBLISH" };	// ControlPoint::AspectMessage
+
+#define NAME(table, x)	((unsigned)(x) < sizeof(table) / sizeof(table[0]) ? table[x] : "?")
+
+static void decode(double t, int event, int id, int a, int b) {
+	printf("%10.3f  ", t);
+	switch (event) {
+	case TRACK:       printf("TRACK     #%-3d %s -> %s\n", id, NAME(trackStates, a), NAME(trackStates, b)); break;
+	case SWITCH:      printf("SWITCH    #%-3d %s -> %s\n", id, NAME(switchStates, a), NAME(switchStates, b)); break;
+	case SWITCHCMD:   printf("SWITCHCMD #%-3d %s -> %s\n", id, NAME(switchStates, a), NAME(switchStates, b)); break;
+	case SIGNAL:      printf("SIGNAL    #%-3d %s -> %s\n", id, NAME(signalStates, a), NAME(signalStates, b)); break;
+	case KNOCKDOWN:   printf("KNOCKDOWN #%-3d reported %s, commanded %s\n", id, NAME(signalStates, a), NAME(signalStates, b)); break;
+	case TIME:
+		if (a) printf("TIME      #%-3d running %d seconds, then %s\n", id, a, NAME(signalStates, b));
+		else   printf("TIME      #%-3d expired, now %s\n", id, NAME(signalStates, b));
+		break;
+	case ASPECT:      printf("ASPECT    #%-3d %s -> %s\n", id, NAME(aspects, a), NAME(aspects, b)); break;
+	case RX:          printf("RX        from %d to %d\n", id, a | (b << 8)); break;
+	case TX:          printf("TX        from %d to %d (low byte), status %d\n", id, a, b); break;
+	case EEPROMWRITE: printf("EEPROM    slot %d saved, checksum 0x%02X\n", id, a); break;
+	case MARK:        printf("MARK      %d %d %d\n", id, a, b); break;
+	case ROUTE:       printf("ROUTE     #%-3d %s, signal #%d\n", id, a ? "locked" : "released", b); break;
+	case DROP:        printf("DROP      from %d to %d, handoff queue full\n", id, (b << 8) | a); break;
+	case NOADDRESS:   printf("NOADDRESS %s refused, control point has no codeline address\n", NAME(messages, a)); break;
+	case FULL:        printf("FULL      %d refused, %s table full\n", id, b ? "CP_LISTENS" : "CP_SUBSCRIBERS"); break;
+	default:          printf("?         event %d: %d %d %d\n", event, id, a, b); break;
+	}
+}
+
+int main(int argc, char **argv) {
+	FILE *in = stdin;
+	if (argc > 1 && !(in = fopen(argv[1], "rb"))) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	unsigned char rec[6];
+	int have = 0;
+	int c;
+	int first = 1;
+	uint16_t last = 0;
+	uint64_t now = 0;	// unwrapped milliseconds since the first event
+
+	while ((c = getc(in)) != EOF) {
+		// every record starts with a byte that has its high bit set; use that to make a
+		// best effort resync if we joined the stream part way through a record
+		if (have == 0 && !(c & 0x80)) continue;
+		rec[have++] = (unsigned char)c;
+		if (have < 6) continue;
+		have = 0;
+
+		uint16_t t = rec[4] | (rec[5] << 8);
+		if (first) {
+			first = 0;
+		} else {
+			now += (uint16_t)(t - last);
+		}
+		last = t;
+		decode(now / 1000.0, rec[0] & 0x7F, rec[1], rec[2], rec[3]);
+	}
+	return 0;
+}